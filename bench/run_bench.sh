@@ -0,0 +1,95 @@
+#!/bin/sh
+# run_bench.sh - time all toad generators on synthetic data
+#
+# usage: run_bench.sh [-n tokens] [-s seed] [-b bindir] [-t tagfile]
+#                     [-c cgndir] [-w workdir] [-o result.json]
+#
+# Generates a corpus of 'tokens' tokens with synthgen, and runs froggen,
+# chunkgen, nergen and morgen on it, each with --timings.
+# The timings of all stages are collected in one JSON file.
+# chunkgen and nergen use the tagger created by froggen.
+# morgen is skipped when the CGN files are not found in 'cgndir'.
+
+tokens=100000
+seed=1
+bindir=../src
+tagfile=../FROGDATA/CGN-POSTAGS
+cgndir=/usr/local/share/frog/nld
+workdir=bench-data
+result=bench.json
+
+while getopts "n:s:b:t:c:w:o:" opt; do
+    case $opt in
+	n) tokens=$OPTARG ;;
+	s) seed=$OPTARG ;;
+	b) bindir=$OPTARG ;;
+	t) tagfile=$OPTARG ;;
+	c) cgndir=$OPTARG ;;
+	w) workdir=$OPTARG ;;
+	o) result=$OPTARG ;;
+	*) echo "usage: $0 [-n tokens] [-s seed] [-b bindir] [-t tagfile] [-c cgndir] [-w workdir] [-o result.json]" >&2
+	   exit 1 ;;
+    esac
+done
+
+fail() {
+    echo "bench: $1 failed, see $workdir/$2.log" >&2
+    exit 1
+}
+
+rm -rf "$workdir"
+mkdir -p "$workdir/data" "$workdir/out" || exit 1
+
+echo "generating $tokens tokens of synthetic data (seed $seed)"
+./synthgen -t "$tagfile" -n "$tokens" -s "$seed" -O "$workdir/data" \
+	   > "$workdir/synthgen.log" 2>&1 || fail synthgen synthgen
+data=$workdir/data
+out=$workdir/out
+
+echo "running froggen"
+"$bindir/froggen" -T "$data/corpus.tagged" -l "$data/lemmas.lst" \
+		  -O "$out/froggen" --temp-dir "$workdir/tmp" \
+		  --timings "$workdir/froggen.json" \
+		  > "$workdir/froggen.log" 2>&1 || fail froggen froggen
+froggen_cfg=$out/froggen/froggen.cfg.template
+
+echo "running chunkgen"
+"$bindir/chunkgen" -c "$froggen_cfg" -O "$out/chunkgen" \
+		   --timings "$workdir/chunkgen.json" "$data/corpus.iob" \
+		   > "$workdir/chunkgen.log" 2>&1 || fail chunkgen chunkgen
+
+echo "running nergen"
+"$bindir/nergen" -c "$froggen_cfg" -O "$out/nergen" \
+		 -g "$data/gazetteer.data" \
+		 --timings "$workdir/nergen.json" "$data/corpus.ner" \
+		 > "$workdir/nergen.log" 2>&1 || fail nergen nergen
+
+tools="froggen chunkgen nergen"
+if [ -f "$cgndir/cgntags.main" ]; then
+    echo "running morgen"
+    "$bindir/morgen" --cgn "$cgndir" -O "$out/morgen" \
+		     --temp-dir "$workdir/tmp" \
+		     --timings "$workdir/morgen.json" "$data/morph.lex" \
+		     > "$workdir/morgen.log" 2>&1 || fail morgen morgen
+    tools="$tools morgen"
+else
+    echo "skipping morgen, no CGN files in $cgndir (use -c)"
+fi
+
+{
+    echo "{"
+    echo "  \"tokens\": $tokens,"
+    echo "  \"seed\": $seed,"
+    echo "  \"host\": \"$(uname -n)\","
+    echo "  \"date\": \"$(date -u +%Y-%m-%dT%H:%M:%SZ)\","
+    echo "  \"results\": ["
+    sep=""
+    for tool in $tools; do
+	printf "%s" "$sep"
+	cat "$workdir/$tool.json"
+	sep=","
+    done
+    echo "  ]"
+    echo "}"
+} > "$result"
+echo "results stored in $result"
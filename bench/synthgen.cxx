@@ -0,0 +1,376 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+// synthgen: generate deterministic synthetic training data for all the
+// toad generators, to benchmark them.
+//
+// The vocabulary and all the choices are drawn from a fixed pseudo random
+// generator, so the same seed and size always give the same files, on
+// every platform.
+
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <set>
+#include "ticcutils/StringOps.h"
+#include "ticcutils/CommandLine.h"
+#include "ticcutils/FileUtils.h"
+#include "config.h"
+
+using namespace std;
+
+class random_source {
+  // splitmix64. Unlike the std:: distributions, the same on every platform
+public:
+  explicit random_source( uint64_t seed ): state( seed ){};
+  uint64_t next(){
+    uint64_t z = ( state += 0x9e3779b97f4a7c15ULL );
+    z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+    z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+    return z ^ ( z >> 31 );
+  }
+  size_t below( size_t n ){
+    return next() % n;
+  }
+  bool chance( int percent ){
+    return below( 100 ) < size_t(percent);
+  }
+private:
+  uint64_t state;
+};
+
+class zipf_table {
+  // draw ranks 0..n-1 with a probability of about 1/(rank+1)
+public:
+  explicit zipf_table( size_t n ){
+    double sum = 0.0;
+    for ( size_t i=0; i < n; ++i ){
+      sum += 1.0 / (i+1);
+      cumulative.push_back( sum );
+    }
+  }
+  size_t draw( random_source& rnd ) const {
+    double r = ( rnd.next() >> 11 ) * ( 1.0 / 9007199254740992.0 );
+    r *= cumulative.back();
+    return lower_bound( cumulative.begin(), cumulative.end(), r )
+      - cumulative.begin();
+  }
+private:
+  vector<double> cumulative;
+};
+
+struct suffix {
+  // a suffix, with the morphological classes of its letters (CELEX style)
+  string letters;
+  vector<string> classes;
+};
+
+const vector<suffix> suffixes = {
+  { "", {} },
+  { "en", { "vm", "0" } },
+  { "end", { "pt", "0", "0" } },
+  { "ende", { "pt", "0", "0", "E" } },
+  { "ing", { "N_V*", "0", "0" } }
+};
+
+const vector<string> onsets = { "b", "d", "f", "g", "h", "k", "l", "m", "n",
+				"p", "r", "s", "t", "v", "w", "z", "br",
+				"dr", "kl", "sch", "st", "tr", "vl", "zw" };
+const vector<string> nuclei = { "a", "e", "i", "o", "u", "aa", "ee", "oo",
+				"ij", "ui", "ou", "ie", "eu" };
+const vector<string> codas = { "", "", "k", "l", "m", "n", "p", "r", "s",
+			       "t", "lt", "nd", "rk", "st" };
+
+struct vocab_entry {
+  string stem;
+  char stem_class;     // N, V or A
+  bool prefixed;       // starts with 'aan'
+  size_t suffix_index;
+  string word;
+  string lemma;
+  vector<size_t> tags; // indices in the tag list, the first is the usual one
+};
+
+vector<string> read_tags( const string& name ){
+  // the tag is the second field of every line starting with '['
+  // the file is latin-1 encoded, the output is UTF-8.
+  vector<string> result;
+  ifstream is( name );
+  if ( !is ){
+    cerr << "unable to open tag file: " << name << endl;
+    exit( EXIT_FAILURE );
+  }
+  string line;
+  while ( getline( is, line ) ){
+    if ( line.empty() || line[0] != '[' ){
+      continue;
+    }
+    vector<string> parts = TiCC::split( line );
+    if ( parts.size() < 2 ){
+      continue;
+    }
+    string tag;
+    for ( const auto c : parts[1] ){
+      unsigned char u = c;
+      if ( u < 0x80 ){
+	tag += c;
+      }
+      else {
+	tag += char( 0xC0 | ( u >> 6 ) );
+	tag += char( 0x80 | ( u & 0x3F ) );
+      }
+    }
+    if ( find( result.begin(), result.end(), tag ) == result.end() ){
+      result.push_back( tag );
+    }
+  }
+  return result;
+}
+
+vector<vocab_entry> make_vocabulary( size_t size,
+				     size_t num_tags,
+				     random_source& rnd ){
+  vector<vocab_entry> result;
+  zipf_table tag_dist( num_tags );
+  set<string> seen;
+  while ( result.size() < size ){
+    vocab_entry e;
+    size_t syllables = 1 + rnd.below( 3 );
+    for ( size_t i=0; i < syllables; ++i ){
+      e.stem += onsets[rnd.below(onsets.size())]
+	+ nuclei[rnd.below(nuclei.size())]
+	+ codas[rnd.below(codas.size())];
+    }
+    e.stem_class = "NVA"[rnd.below(3)];
+    e.prefixed = rnd.chance( 10 );
+    e.suffix_index = rnd.below( suffixes.size() );
+    e.word = ( e.prefixed ? "aan" : "" ) + e.stem
+      + suffixes[e.suffix_index].letters;
+    if ( !seen.insert( e.word ).second ){
+      continue;
+    }
+    e.lemma = ( e.prefixed ? "aan" : "" ) + e.stem
+      + ( e.stem_class == 'V' ? "en" : "" );
+    e.tags.push_back( tag_dist.draw( rnd ) );
+    if ( rnd.chance( 20 ) ){
+      // an ambiguous word
+      e.tags.push_back( tag_dist.draw( rnd ) );
+    }
+    result.push_back( e );
+  }
+  return result;
+}
+
+string morph_line( const vocab_entry& e ){
+  // the word, followed by the class of every letter
+  string line = e.word;
+  if ( e.prefixed ){
+    line += " P 0 0";
+  }
+  for ( size_t i=0; i < e.stem.size(); ++i ){
+    line += " ";
+    line += ( i == 0 ? string( 1, e.stem_class ) : "0" );
+  }
+  for ( const auto& c : suffixes[e.suffix_index].classes ){
+    line += " " + c;
+  }
+  return line;
+}
+
+void usage( const string& name ){
+  cerr << name << " -t tagfile [-n tokens] [-s seed] [-O outputdir]" << endl;
+  cerr << name << " generates synthetic, but deterministic, data for\n"
+       << " froggen, chunkgen, nergen and morgen." << endl;
+  cerr << "-t 'tagfile' a file with POS tags, like FROGDATA/CGN-POSTAGS"
+       << endl;
+  cerr << "-n 'tokens' the number of tokens in the corpora (default 100000)"
+       << endl;
+  cerr << "-s 'seed' the seed for the random generator (default 1)" << endl;
+  cerr << "-O 'outputdir' where to store the files (default .)" << endl;
+  cerr << "It creates:\n"
+       << "\tcorpus.tagged\ta tagged corpus for froggen: Word Lemma POS\n"
+       << "\tlemmas.lst\ta lemma list for froggen\n"
+       << "\tcorpus.iob\tan IOB tagged corpus for chunkgen\n"
+       << "\tcorpus.ner\tan NER tagged corpus for nergen\n"
+       << "\tgazetteer.data\tthe gazetteer for nergen, with its lists\n"
+       << "\tmorph.lex\ta CELEX style morphology lexicon for morgen" << endl;
+}
+
+int main( int argc, char * const argv[] ){
+  TiCC::CL_Options opts( "t:n:s:O:hV", "help,version" );
+  try {
+    opts.parse_args( argc, argv );
+  }
+  catch ( const exception& e ){
+    cerr << e.what() << endl;
+    exit( EXIT_FAILURE );
+  }
+  if ( opts.extract( 'h' ) || opts.extract( "help" ) ){
+    usage( opts.prog_name() );
+    exit( EXIT_SUCCESS );
+  }
+  if ( opts.extract( 'V' ) || opts.extract( "version" ) ){
+    cerr << "VERSION: " << VERSION << endl;
+    exit( EXIT_SUCCESS );
+  }
+  string tag_file;
+  if ( !opts.extract( 't', tag_file ) ){
+    cerr << "missing a tagfile (-t option)" << endl;
+    usage( opts.prog_name() );
+    exit( EXIT_FAILURE );
+  }
+  size_t tokens = 100000;
+  uint64_t seed = 1;
+  string value;
+  if ( opts.extract( 'n', value )
+       && ( !TiCC::stringTo( value, tokens ) || tokens == 0 ) ){
+    cerr << "illegal value for -n (" << value << ")" << endl;
+    exit( EXIT_FAILURE );
+  }
+  if ( opts.extract( 's', value )
+       && !TiCC::stringTo( value, seed ) ){
+    cerr << "illegal value for -s (" << value << ")" << endl;
+    exit( EXIT_FAILURE );
+  }
+  string output_dir;
+  opts.extract( 'O', output_dir );
+  if ( !output_dir.empty() ){
+    if ( output_dir.back() != '/' ){
+      output_dir += "/";
+    }
+    if ( !TiCC::isDir( output_dir ) && !TiCC::createPath( output_dir ) ){
+      cerr << "output dir not usable: " << output_dir << endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+  if ( !opts.empty() ){
+    cerr << "spurious options found: " << opts << endl;
+    exit( EXIT_FAILURE );
+  }
+  vector<string> tags = read_tags( tag_file );
+  if ( tags.empty() ){
+    cerr << "no tags found in: " << tag_file << endl;
+    exit( EXIT_FAILURE );
+  }
+  cout << "found " << tags.size() << " tags in " << tag_file << endl;
+  random_source rnd( seed );
+  // a vocabulary size that grows sub linear, like in real text
+  size_t vocab_size = min<size_t>( max<size_t>( tokens / 8, 100 ), 500000 );
+  vector<vocab_entry> vocab = make_vocabulary( vocab_size, tags.size(), rnd );
+  zipf_table word_dist( vocab.size() );
+
+  // the tagged corpus, and the IOB and NER corpora over the same sentences
+  ofstream corpus( output_dir + "corpus.tagged" );
+  ofstream iob( output_dir + "corpus.iob" );
+  ofstream ner( output_dir + "corpus.ner" );
+  const vector<string> chunk_types = { "NP", "VP", "PP", "ADJP", "ADVP" };
+  const vector<string> ner_types = { "per", "loc", "org", "pro", "eve",
+				     "misc" };
+  vector<vector<string>> gazetteer( ner_types.size() );
+  size_t done = 0;
+  while ( done < tokens ){
+    size_t len = min( 5 + rnd.below( 21 ), tokens - done );
+    string chunk;
+    string entity;
+    for ( size_t i=0; i < len; ++i ){
+      const vocab_entry& e = vocab[word_dist.draw( rnd )];
+      size_t tag = e.tags[ rnd.chance( 80 ) ? 0 : e.tags.size()-1 ];
+      corpus << e.word << "\t" << e.lemma << "\t" << tags[tag] << "\n";
+      if ( chunk.empty() || rnd.chance( 40 ) ){
+	chunk = rnd.chance( 10 ) ? "O"
+	  : chunk_types[rnd.below( chunk_types.size() )];
+	iob << e.word << "\t" << ( chunk == "O" ? "O" : "B-" + chunk ) << "\n";
+      }
+      else {
+	iob << e.word << "\t" << ( chunk == "O" ? "O" : "I-" + chunk ) << "\n";
+      }
+      if ( !entity.empty() && rnd.chance( 50 ) ){
+	ner << e.word << "\tI-" << entity << "\n";
+      }
+      else if ( rnd.chance( 8 ) ){
+	size_t type = rnd.below( ner_types.size() );
+	entity = ner_types[type];
+	ner << e.word << "\tB-" << entity << "\n";
+	if ( gazetteer[type].size() < 1000 ){
+	  gazetteer[type].push_back( e.word );
+	}
+      }
+      else {
+	entity.clear();
+	ner << e.word << "\tO\n";
+      }
+    }
+    corpus << "<utt>\n";
+    iob << "\n";
+    ner << "\n";
+    done += len;
+  }
+  cout << "created corpora of " << done << " tokens" << endl;
+
+  // an extra lemma list, with words from the tail of the vocabulary
+  ofstream lemmas( output_dir + "lemmas.lst" );
+  for ( size_t i=vocab.size()/2; i < vocab.size(); ++i ){
+    const vocab_entry& e = vocab[i];
+    for ( const auto tag : e.tags ){
+      lemmas << e.word << "\t" << e.lemma << "\t" << tags[tag] << "\n";
+    }
+  }
+
+  // the gazetteer
+  ofstream gaz( output_dir + "gazetteer.data" );
+  for ( size_t i=0; i < ner_types.size(); ++i ){
+    string list = "gazetteer." + ner_types[i] + ".lst";
+    gaz << ner_types[i] << "\t" << list << "\n";
+    ofstream ls( output_dir + list );
+    sort( gazetteer[i].begin(), gazetteer[i].end() );
+    gazetteer[i].erase( unique( gazetteer[i].begin(), gazetteer[i].end() ),
+			gazetteer[i].end() );
+    for ( const auto& w : gazetteer[i] ){
+      ls << w << "\n";
+    }
+  }
+
+  // the morphology lexicon, sorted like CELEX
+  vector<const vocab_entry*> morphs;
+  for ( const auto& e : vocab ){
+    morphs.push_back( &e );
+  }
+  sort( morphs.begin(), morphs.end(),
+	[]( const vocab_entry *a, const vocab_entry *b ){
+	  return a->word < b->word; } );
+  ofstream lex( output_dir + "morph.lex" );
+  for ( const auto e : morphs ){
+    lex << morph_line( *e ) << "\n";
+  }
+  cout << "created a lemma list of " << vocab.size() - vocab.size()/2
+       << " words and a morphology lexicon of " << morphs.size()
+       << " words in: " << ( output_dir.empty() ? "." : output_dir ) << endl;
+  return EXIT_SUCCESS;
+}
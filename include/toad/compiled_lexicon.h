@@ -0,0 +1,78 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_COMPILED_LEXICON_H
+#define TOAD_COMPILED_LEXICON_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// a set of words in a compact, sorted and front coded table, which can
+// be stored in a file and memory mapped.
+//
+// The words are sorted on their UTF-8 bytes and cut in blocks of 16.
+// The first word of a block is stored completely, the others only store
+// the length of the prefix they share with the previous word, and the
+// rest. contains() does a binary search on the first words of the blocks,
+// and then scans one block, comparing bytes, without decoding the words.
+//
+// compile() writes the table to a file, together with the size and
+// modification time of the files the words came from, so is_stale() can
+// detect that it is out of date. open() maps such a file, build() creates
+// the same table in memory.
+class compiled_lexicon {
+ public:
+  compiled_lexicon();
+  ~compiled_lexicon();
+  compiled_lexicon( const compiled_lexicon& ) = delete;
+  compiled_lexicon& operator=( const compiled_lexicon& ) = delete;
+  static bool compile( std::vector<std::string>&,
+		       const std::vector<std::string>&,
+		       const std::string& );
+  void build( std::vector<std::string>& );
+  bool open( const std::string& );
+  void close();
+  bool is_open() const { return _data != 0; };
+  bool is_stale() const;
+  size_t size() const;
+  bool contains( const char *, size_t ) const;
+  bool contains( const std::string& s ) const {
+    return contains( s.data(), s.size() );
+  };
+ private:
+  struct header;
+  static std::string make_image( std::vector<std::string>&,
+				 const std::string& );
+  bool check_header();
+  const char *_data;
+  size_t _size;
+  bool _mapped;
+  std::string _image;   // the table, when build() made it
+  const header *_header;
+};
+
+#endif // TOAD_COMPILED_LEXICON_H
@@ -0,0 +1,52 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_CONTENT_HASH_H
+#define TOAD_CONTENT_HASH_H
+
+#include <cstdint>
+#include <string>
+
+// a 64 bit FNV-1a hash over a sequence of strings and file contents.
+//
+// Used to detect if the inputs of some expensive step have changed since
+// the last run. Every string is prefixed by its length, so "ab","c" and
+// "a","bc" give different hashes.
+// This is NOT a cryptographic hash.
+class content_hash {
+ public:
+  content_hash();
+  content_hash& add( const char *, size_t );
+  content_hash& add( const std::string& );
+  bool add_file( const std::string& );
+  uint64_t value() const { return _hash; };
+  std::string hex() const;
+ private:
+  void update( const char *, size_t );
+  uint64_t _hash;
+};
+
+#endif // TOAD_CONTENT_HASH_H
@@ -0,0 +1,152 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_FEATURE_WINDOW_H
+#define TOAD_FEATURE_WINDOW_H
+
+#include <cstddef>
+#include <string>
+#include "unicode/unistr.h"
+
+// the context window features of the instances the generators create.
+//
+// For position 'i' of a column (a sequence of tags, or the characters of a
+// word), the window holds the items from LEFT positions before up to RIGHT
+// positions after it. Every item is followed by a separator. Positions
+// outside the sequence give "_".
+// The items are written straight to the output, nothing is concatenated.
+//
+// window_features<LEFT,RIGHT> is the version with fixed widths, where the
+// compiler unrolls the loops. feature_window picks one of those for the
+// common widths, and falls back to a loop for other widths.
+
+namespace window_detail {
+  inline size_t length( const icu::UnicodeString& s ){ return s.length(); }
+  template <typename Seq>
+  inline size_t length( const Seq& s ){ return s.size(); }
+}
+
+template <size_t LEFT, size_t RIGHT>
+struct window_features {
+  template <typename Out, typename Seq>
+  static void write( Out& os, const Seq& seq, size_t i, const char *sep ){
+    const size_t len = window_detail::length( seq );
+    for ( size_t k=LEFT; k > 0; --k ){
+      if ( i < k ){
+	os << "_";
+      }
+      else {
+	os << seq[i-k];
+      }
+      os << sep;
+    }
+    os << seq[i] << sep;
+    for ( size_t k=1; k <= RIGHT; ++k ){
+      if ( i + k >= len ){
+	os << "_";
+      }
+      else {
+	os << seq[i+k];
+      }
+      os << sep;
+    }
+  }
+};
+
+class feature_window {
+ public:
+  feature_window( size_t left, size_t right ):
+    _left( left ),
+    _right( right ),
+    _fixed( left == right && ( left == 1 || left == 2 || left == 3
+			       || left == 6 ) )
+  {};
+  size_t left() const { return _left; };
+  size_t right() const { return _right; };
+  size_t width() const { return _left + 1 + _right; };
+  // write the window around position 'i' of every column, in turn
+  template <typename Out, typename Seq, typename... Seqs>
+  void write( Out& os, const char *sep, size_t i,
+	      const Seq& column, const Seqs&... more ) const {
+    write_one( os, column, i, sep );
+    write( os, sep, i, more... );
+  }
+  template <typename Out>
+  void write( Out&, const char *, size_t ) const {}
+ private:
+  template <typename Out, typename Seq>
+  void write_one( Out& os, const Seq& seq, size_t i, const char *sep ) const {
+    if ( _fixed ){
+      switch ( _left ){
+      case 1:
+	return window_features<1,1>::write( os, seq, i, sep );
+      case 2:
+	return window_features<2,2>::write( os, seq, i, sep );
+      case 3:
+	return window_features<3,3>::write( os, seq, i, sep );
+      case 6:
+	return window_features<6,6>::write( os, seq, i, sep );
+      }
+    }
+    const size_t len = window_detail::length( seq );
+    for ( size_t k=_left; k > 0; --k ){
+      if ( i < k ){
+	os << "_";
+      }
+      else {
+	os << seq[i-k];
+      }
+      os << sep;
+    }
+    os << seq[i] << sep;
+    for ( size_t k=1; k <= _right; ++k ){
+      if ( i + k >= len ){
+	os << "_";
+      }
+      else {
+	os << seq[i+k];
+      }
+      os << sep;
+    }
+  }
+  size_t _left;
+  size_t _right;
+  bool _fixed;
+};
+
+namespace TiCC {
+  class Configuration;
+}
+
+// set the widths of 'window' from the left_context and right_context keys
+// of 'module' in 'config'. 'window' should hold the widths Frog uses, we
+// warn when they differ, as Frog can't use the model then.
+// returns false, after reporting, on an illegal value.
+bool context_window( const TiCC::Configuration& config,
+		     const std::string& module,
+		     feature_window& window );
+
+#endif // TOAD_FEATURE_WINDOW_H
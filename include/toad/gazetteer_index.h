@@ -0,0 +1,77 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_GAZETTEER_INDEX_H
+#define TOAD_GAZETTEER_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "unicode/unistr.h"
+
+// a compiled NER gazetteer, which is memory mapped.
+//
+// A gazetteer file lists lines 'category<tab>listfile'. Every list file
+// holds one name per line, consisting of one or more space separated
+// tokens.
+// compile() stores all names in a token trie: every token is replaced by
+// its id in a sorted token table, and every node has its children sorted
+// on that id. Nodes where a name ends carry the set of its categories.
+// The index also records a hash of the gazetteer file and all list files,
+// so is_stale() can detect that it is out of date.
+//
+// lookup() gives the categories for every word of a sentence, the same way
+// Frog's NERTagger::create_ner_list() does: every sequence of up to
+// max_ner_size words that is a name adds its categories to all its words.
+// More categories are joined with '+', words not in a name get 'O'.
+class gazetteer_index {
+ public:
+  gazetteer_index();
+  ~gazetteer_index();
+  gazetteer_index( const gazetteer_index& ) = delete;
+  gazetteer_index& operator=( const gazetteer_index& ) = delete;
+  static bool compile( const std::string&, const std::string&, size_t );
+  bool open( const std::string& );
+  void close();
+  bool is_open() const { return _data != 0; };
+  bool is_stale() const;
+  size_t names() const;
+  std::vector<icu::UnicodeString>
+    lookup( const std::vector<icu::UnicodeString>& ) const;
+ private:
+  struct header;
+  struct node;
+  uint32_t find_token( const std::string& ) const;
+  const node *find_child( const node *, uint32_t ) const;
+  std::string string_at( uint64_t, uint64_t ) const;
+  const char *_data;
+  size_t _size;
+  const header *_header;
+  std::vector<icu::UnicodeString> _categories; // the decoded names
+  std::vector<const uint32_t*> _sets; // per set: the count, then the ids
+};
+
+#endif // TOAD_GAZETTEER_INDEX_H
@@ -0,0 +1,66 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_INSTANCE_AGGREGATOR_H
+#define TOAD_INSTANCE_AGGREGATOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+class output_writer;
+
+// collapse identical Timbl instances.
+//
+// An instance is a line of features and a class, the class comes after the
+// last separator. Instances with the same features become one, with the
+// classes of all of them merged: every class is split at '|', and the
+// union is joined with '|' again, sorted. That is how the generators
+// already give more than one class to an instance.
+// The number of instances collapsed into each one is kept, and can be
+// written as an exemplar weight (Timbl's -s option).
+// The instances are written in the order they were first seen.
+class instance_aggregator {
+ public:
+  explicit instance_aggregator( char sep ): _sep( sep ) {};
+  void add( const std::string& );
+  bool add_file( const std::string& );
+  size_t instances() const { return _instances; };
+  size_t size() const { return _order.size(); };
+  void write( output_writer&, bool weights ) const;
+ private:
+  struct aggregate {
+    std::string classes;
+    uint64_t count = 0;
+  };
+  char _sep;
+  size_t _instances = 0;
+  std::unordered_map<std::string,aggregate> _aggregates;
+  std::vector<const std::pair<const std::string,aggregate>*> _order;
+};
+
+#endif // TOAD_INSTANCE_AGGREGATOR_H
@@ -0,0 +1,53 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_INSTANCE_FILE_H
+#define TOAD_INSTANCE_FILE_H
+
+#include <string>
+
+// the name of a file to collect Timbl instances in.
+//
+// Timbl only learns from a named file, which it reads more than once.
+// When possible, the file lives in memory (an anonymous memfd), which is
+// only reachable through a /proc/self/fd/ name, and disappears when this
+// object is destroyed. So nothing is written in the temp dir.
+// When 'keep' is true, or memory files are not supported, we fall back to
+// a real file with the given name, which is kept for inspection.
+class instance_file {
+ public:
+  instance_file( const std::string&, bool );
+  ~instance_file();
+  instance_file( const instance_file& ) = delete;
+  instance_file& operator=( const instance_file& ) = delete;
+  const std::string& name() const { return _name; };
+  bool in_memory() const { return _fd >= 0; };
+ private:
+  std::string _name;
+  int _fd;
+};
+
+#endif // TOAD_INSTANCE_FILE_H
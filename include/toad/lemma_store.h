@@ -0,0 +1,76 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_LEMMA_STORE_H
+#define TOAD_LEMMA_STORE_H
+
+#include <cstdint>
+#include <vector>
+#include "unicode/unistr.h"
+
+// frequencies of (word, lemma, POS tag) triples.
+//
+// All strings are interned: they are stored once in one contiguous arena
+// and referred to by a 32 bit id. The same id is used when a string occurs
+// as a word, as a lemma or as a tag.
+// The counts are kept in a flat open-addressing hash table keyed on the
+// 3 ids.
+class lemma_store {
+ public:
+  struct entry {
+    uint32_t word;
+    uint32_t lemma;
+    uint32_t tag;
+    size_t count;
+  };
+  lemma_store();
+  void add( const icu::UnicodeString&,
+	    const icu::UnicodeString&,
+	    const icu::UnicodeString&,
+	    size_t = 1 );
+  void merge( const lemma_store& );
+  bool empty() const { return _entries.empty(); };
+  size_t size() const { return _word_count; };
+  size_t triples() const { return _entries.size(); };
+  size_t strings() const { return _offsets.size() - 1; };
+  size_t memory_usage() const;
+  icu::UnicodeString str( uint32_t ) const;
+  std::vector<entry> sorted() const;
+ private:
+  uint32_t intern( const icu::UnicodeString& );
+  uint64_t str_hash( uint32_t ) const;
+  void grow_strings();
+  void grow_entries();
+  std::vector<char16_t> _arena;
+  std::vector<uint32_t> _offsets;     // start of string i is _offsets[i]
+  std::vector<uint32_t> _str_table;   // open-addressing index on the strings
+  std::vector<bool> _is_word;
+  size_t _word_count;
+  std::vector<entry> _entries;
+  std::vector<uint32_t> _entry_table; // open-addressing index on _entries
+};
+
+#endif // TOAD_LEMMA_STORE_H
@@ -0,0 +1,216 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_ORDERED_PIPELINE_H
+#define TOAD_ORDERED_PIPELINE_H
+
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <deque>
+#include <map>
+#include <vector>
+
+// process a stream of jobs with a pool of worker threads, and hand over
+// the results in the original order.
+//
+// run() calls:
+//   produce( job ) to get the next job, until it returns false. This is
+//     done in a reader thread.
+//   work( worker_id, job ) to turn a job into a result. Each worker has
+//     its own id in [0,workers), so it can use its own (not thread safe)
+//     resources, like a tagger.
+//   consume( result ) for every result, in the order of the jobs. This is
+//     done in the thread that called run().
+// At most 'capacity' jobs are queued, in work or waiting to be consumed,
+// so the memory use is bounded, however slow the consumer is.
+// With only 1 worker, everything is done in the calling thread.
+// When one of the functions throws, everything stops, and run() rethrows
+// the (first) exception.
+// A pipeline can only run once.
+template <typename Job, typename Result>
+class ordered_pipeline {
+ public:
+  using producer = std::function<bool(Job&)>;
+  using worker = std::function<Result(size_t,Job&)>;
+  using consumer = std::function<void(Result&)>;
+  ordered_pipeline( size_t workers, size_t capacity ):
+    _workers( workers == 0 ? 1 : workers ),
+    _capacity( capacity < _workers ? 2*_workers : capacity )
+  {};
+  void run( const producer&, const worker&, const consumer& );
+ private:
+  void read( const producer& );
+  void process( size_t, const worker& );
+  void fail();
+  size_t _workers;
+  size_t _capacity;
+  std::mutex _lock;
+  std::condition_variable _changed;
+  std::deque<std::pair<size_t,Job>> _jobs;
+  std::map<size_t,Result> _done;
+  size_t _produced = 0;  // the number of jobs read
+  size_t _in_flight = 0; // read, but not yet consumed
+  bool _eof = false;
+  bool _stop = false;
+  std::exception_ptr _error;
+};
+
+template <typename Job, typename Result>
+void ordered_pipeline<Job,Result>::fail(){
+  // called with the lock held
+  if ( !_error ){
+    _error = std::current_exception();
+  }
+  _stop = true;
+  _changed.notify_all();
+}
+
+template <typename Job, typename Result>
+void ordered_pipeline<Job,Result>::read( const producer& produce ){
+  while ( true ){
+    {
+      std::unique_lock<std::mutex> guard( _lock );
+      _changed.wait( guard, [this]{ return _stop || _in_flight < _capacity; } );
+      if ( _stop ){
+	return;
+      }
+    }
+    Job job;
+    bool more;
+    try {
+      more = produce( job );
+    }
+    catch ( ... ){
+      std::lock_guard<std::mutex> guard( _lock );
+      fail();
+      return;
+    }
+    std::lock_guard<std::mutex> guard( _lock );
+    if ( !more ){
+      _eof = true;
+      _changed.notify_all();
+      return;
+    }
+    _jobs.emplace_back( _produced++, std::move(job) );
+    ++_in_flight;
+    _changed.notify_all();
+  }
+}
+
+template <typename Job, typename Result>
+void ordered_pipeline<Job,Result>::process( size_t id, const worker& work ){
+  while ( true ){
+    std::pair<size_t,Job> job;
+    {
+      std::unique_lock<std::mutex> guard( _lock );
+      _changed.wait( guard,
+		     [this]{ return _stop || _eof || !_jobs.empty(); } );
+      if ( _stop || _jobs.empty() ){
+	return;
+      }
+      job = std::move( _jobs.front() );
+      _jobs.pop_front();
+    }
+    try {
+      Result result = work( id, job.second );
+      std::lock_guard<std::mutex> guard( _lock );
+      _done.emplace( job.first, std::move(result) );
+      _changed.notify_all();
+    }
+    catch ( ... ){
+      std::lock_guard<std::mutex> guard( _lock );
+      fail();
+      return;
+    }
+  }
+}
+
+template <typename Job, typename Result>
+void ordered_pipeline<Job,Result>::run( const producer& produce,
+					const worker& work,
+					const consumer& consume ){
+  if ( _workers == 1 ){
+    Job job;
+    while ( produce( job ) ){
+      Result result = work( 0, job );
+      consume( result );
+      job = Job();
+    }
+    return;
+  }
+  std::thread reader( [&]{ read( produce ); } );
+  std::vector<std::thread> pool;
+  for ( size_t i=0; i < _workers; ++i ){
+    pool.emplace_back( [&,i]{ process( i, work ); } );
+  }
+  size_t next = 0;
+  while ( true ){
+    Result result;
+    {
+      std::unique_lock<std::mutex> guard( _lock );
+      _changed.wait( guard,
+		     [&]{ return _stop
+			  || _done.count( next ) > 0
+			  || ( _eof && next == _produced ); } );
+      if ( _stop || _done.count( next ) == 0 ){
+	break;
+      }
+      auto it = _done.find( next );
+      result = std::move( it->second );
+      _done.erase( it );
+      --_in_flight;
+      _changed.notify_all();
+    }
+    try {
+      consume( result );
+    }
+    catch ( ... ){
+      std::lock_guard<std::mutex> guard( _lock );
+      fail();
+      break;
+    }
+    ++next;
+  }
+  {
+    // make sure everybody stops, also when we are done
+    std::lock_guard<std::mutex> guard( _lock );
+    _stop = true;
+    _changed.notify_all();
+  }
+  reader.join();
+  for ( auto& t : pool ){
+    t.join();
+  }
+  if ( _error ){
+    std::rethrow_exception( _error );
+  }
+}
+
+#endif // TOAD_ORDERED_PIPELINE_H
@@ -0,0 +1,87 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_OUTPUT_WRITER_H
+#define TOAD_OUTPUT_WRITER_H
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "unicode/unistr.h"
+
+// a buffered UTF-8 writer for the (large) outputfiles of the generators.
+//
+// UnicodeStrings are encoded straight into a large buffer, which is written
+// as one block when it is full. Nothing is flushed per line, so use "\n",
+// there is no endl.
+// With 'background', the full blocks are written by a separate thread while
+// the next block is filled. The two buffers are swapped, and reused.
+// A writer that is not opened collects everything in memory, see str().
+class output_writer {
+ public:
+  output_writer();
+  explicit output_writer( const std::string&, bool background = false );
+  ~output_writer();
+  output_writer( const output_writer& ) = delete;
+  output_writer& operator=( const output_writer& ) = delete;
+  bool open( const std::string&, bool background = false );
+  bool close();
+  bool good() const;
+  explicit operator bool() const { return good(); };
+  output_writer& write( const char *, size_t );
+  output_writer& operator<<( const icu::UnicodeString& );
+  output_writer& operator<<( const std::string& s ){
+    return write( s.data(), s.size() );
+  };
+  output_writer& operator<<( const char * );
+  output_writer& operator<<( char );
+  output_writer& operator<<( char16_t );
+  output_writer& operator<<( size_t );
+  const std::string& str() const { return _buffer; };
+  void clear() { _buffer.clear(); };
+  uint64_t bytes_written() const { return _written; };
+ private:
+  void next_block();
+  void write_block( const std::string& );
+  void background_writer();
+  std::string _buffer;
+  std::string _pending;  // the block the background thread is writing
+  int _fd;
+  bool _failed;
+  bool _done;
+  uint64_t _written;
+  std::thread _thread;
+  mutable std::mutex _lock;
+  std::condition_variable _cv;
+};
+
+// encode one UTF-16 unit 'c' as UTF-8 into 'buf' (at least 3 bytes).
+// returns the number of bytes used
+size_t utf8_unit( char16_t c, char *buf );
+
+#endif // TOAD_OUTPUT_WRITER_H
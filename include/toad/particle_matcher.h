@@ -0,0 +1,66 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_PARTICLE_MATCHER_H
+#define TOAD_PARTICLE_MATCHER_H
+
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <set>
+#include "unicode/unistr.h"
+
+// the particle configuration of the lemmatizer, compiled once.
+//
+// All particles go into one Aho-Corasick automaton, so one scan over a
+// wordform finds the first occurrence of every particle. The position of a
+// match is the same as UnicodeString::indexOf() would give.
+class particle_matcher {
+ public:
+  explicit particle_matcher( const std::map<icu::UnicodeString,
+			     std::set<icu::UnicodeString>>& );
+  size_t size() const { return _particles.size(); };
+  const icu::UnicodeString& particle( size_t id ) const {
+    return _particles[id];
+  };
+  std::vector<uint32_t> candidates( const icu::UnicodeString& ) const;
+  void first_positions( const icu::UnicodeString&,
+			std::vector<int>& ) const;
+ private:
+  struct state {
+    std::vector<std::pair<char16_t,uint32_t>> next; // sorted on char
+    uint32_t fail = 0;
+    uint32_t out_link = 0;      // next state on the fail chain with output
+    std::vector<uint32_t> out;  // the particles ending here
+  };
+  uint32_t go( uint32_t, char16_t ) const;
+  uint32_t step( uint32_t, char16_t ) const;
+  std::vector<icu::UnicodeString> _particles;
+  std::vector<std::pair<icu::UnicodeString,std::vector<uint32_t>>> _tags;
+  std::vector<state> _states;
+};
+
+#endif // TOAD_PARTICLE_MATCHER_H
@@ -0,0 +1,117 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_STAGE_TIMER_H
+#define TOAD_STAGE_TIMER_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <ostream>
+
+// accumulates the wall clock time of a piece of work, which may be
+// started and stopped many times, and its CPU time.
+// By default that is the CPU time of the whole process, so the threads
+// started for the work (like an OpenMP loop) are included, but so is
+// anything else running at the same time. A THREAD stopwatch only counts
+// the calling thread; that is the one to use in a worker of a pool, or
+// in the reader or writer next to it.
+// Stopwatches can be added (the work of several threads) and subtracted
+// (what remains of a total).
+class stopwatch {
+ public:
+  enum cpu_scope { PROCESS, THREAD };
+  explicit stopwatch( cpu_scope scope = PROCESS ):
+    _total(0.0), _cpu_total(0.0), _cpu_start(0.0), _scope(scope),
+    _running(false) {};
+  void start();
+  void stop();
+  double seconds() const { return _total; };
+  double cpu_seconds() const { return _cpu_total; };
+  stopwatch& operator+=( const stopwatch& );
+  stopwatch& operator-=( const stopwatch& );
+ private:
+  std::chrono::steady_clock::time_point _start;
+  double _total;
+  double _cpu_total;
+  double _cpu_start;
+  cpu_scope _scope;
+  bool _running;
+};
+
+// the time spent in every stage of a program, and the number of tokens
+// handled in that stage. Stages are reported in the order they are first
+// added. Also keeps totals for the whole program, like "lines" or
+// "bytes_read", which are reported with their rate per second.
+// Safe to use from several threads.
+class stage_timer {
+ public:
+  stage_timer();
+  void add( const std::string&, const stopwatch&, size_t = 0 );
+  void count( const std::string&, uint64_t );
+  double elapsed() const;
+  void write_json( std::ostream&, const std::string& ) const;
+  bool write_json( const std::string&, const std::string& ) const;
+  static long peak_rss();
+  static double cpu_seconds();
+ private:
+  struct stage {
+    std::string name;
+    double seconds;
+    double cpu_seconds;
+    size_t tokens;
+  };
+  std::chrono::steady_clock::time_point _begin;
+  std::vector<stage> _stages;
+  std::vector<std::pair<std::string,uint64_t>> _counts;
+  mutable std::mutex _lock;
+};
+
+// prints a line about the progress every 'interval' seconds, with an
+// estimate of the remaining time, based on the number of bytes of the
+// input file that are handled.
+// Does nothing until started. Not thread safe: call update() from one
+// thread.
+class progress_meter {
+ public:
+  progress_meter();
+  void start( const std::string&, const std::string&, double = 10.0 );
+  bool active() const { return _active; };
+  void update( uint64_t, size_t );
+  void finish( uint64_t, size_t );
+ private:
+  void report( uint64_t, size_t, bool );
+  bool _active;
+  std::string _unit;
+  uint64_t _total_bytes;
+  double _interval;
+  std::chrono::steady_clock::time_point _begin;
+  std::chrono::steady_clock::time_point _next;
+};
+
+#endif // TOAD_STAGE_TIMER_H
@@ -0,0 +1,76 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef TOAD_TAG_CACHE_H
+#define TOAD_TAG_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include "unicode/unistr.h"
+
+// a persistent cache of POS tagger results, shared by chunkgen and nergen.
+//
+// The key of a sentence is a hash of its text. The file starts with a
+// fingerprint of the tagger: a hash of its options, its settings and the
+// contents of all the files these mention, but not of any path. So a tagger
+// that is moved or used by another path keeps its fingerprint. When the
+// tagger changed, the old entries are dropped. Every other line holds the
+// key of a sentence, followed by its words and tags, all tab separated.
+// New entries are appended by save(). lookup() and store() are thread safe.
+class tag_cache {
+ public:
+  tag_cache();
+  tag_cache( const tag_cache& ) = delete;
+  tag_cache& operator=( const tag_cache& ) = delete;
+  static std::string tagger_fingerprint( const std::string&,
+					 const std::string& );
+  bool open( const std::string&, const std::string& );
+  bool is_open() const { return !_filename.empty(); };
+  bool lookup( const icu::UnicodeString&,
+	       std::vector<icu::UnicodeString>&,
+	       std::vector<icu::UnicodeString>& );
+  void store( const icu::UnicodeString&,
+	      const std::vector<icu::UnicodeString>&,
+	      const std::vector<icu::UnicodeString>& );
+  bool save();
+  size_t hits() const { return _hits; };
+  size_t misses() const { return _misses; };
+  size_t size() const { return _entries.size(); };
+ private:
+  std::string _filename;
+  std::string _fingerprint;
+  bool _rewrite;
+  std::unordered_map<uint64_t,std::string> _entries;
+  std::vector<uint64_t> _added;
+  size_t _hits;
+  size_t _misses;
+  std::mutex _lock;
+};
+
+#endif // TOAD_TAG_CACHE_H
@@ -31,6 +31,8 @@
 #include <map>
 #include <string>
 #include <cstdlib>
+#include <sstream>
+#include <algorithm>
 #include "timbl/TimblAPI.h"
 #include "ticcutils/StringOps.h"
 #include "ticcutils/LogStream.h"
@@ -40,6 +42,8 @@
 #include "ucto/tokenize.h"
 #include "frog/FrogAPI.h"
 #include "frog/mblem_mod.h"
+#include "toad/compiled_lexicon.h"
+#include "toad/ordered_pipeline.h"
 
 using namespace std;
 using namespace	icu;
@@ -52,7 +56,15 @@ static string configDir = string(SYSCONF_PATH) + "/frog/nld/";
 static string configFileName = configDir + "frog.cfg";
 
 void usage(){
-  cerr << "checkmblem [-i inputfile]" << endl;
+  cerr << "checkmblem [-i inputfile] [--compile] [--threads n]" << endl;
+  cerr << "\t --threads <n> check with 'n' threads, each with its own Mblem."
+       << endl
+       << "\t\t The reports are in the same order as with 1 thread."
+       << endl;
+  cerr << "\t --compile store the lexicon of known lemmas in"
+       << " 'inputfile'.lemmas.idx," << endl
+       << "\t\t and stop. Later runs load that, instead of building the"
+       << " lexicon." << endl;
 }
 
 bool isException( const UnicodeString& s ){
@@ -62,8 +74,150 @@ bool isException( const UnicodeString& s ){
   return false;
 }
 
+void add_words( const string& filename, vector<string>& words ){
+  // add the first word of every line of 'filename', if it exists
+  ifstream is( filename );
+  UnicodeString uline;
+  while ( TiCC::getline( is, uline ) ){
+    if ( uline.isEmpty() ){
+      continue;
+    }
+    vector<UnicodeString> vec = TiCC::split( uline );
+    if ( !vec.empty() ){
+      words.push_back( TiCC::UnicodeToUTF8( vec[0] ) );
+    }
+  }
+}
+
+struct lemma_entry {
+  // a lowercase word to check, or a line with a problem
+  UnicodeString text;
+  bool problem;
+};
+
+void read_input( const string& inpname,
+		 vector<string> *lemmas,
+		 vector<lemma_entry> *entries ){
+  // read the input once, for both the lexicon and the words to check.
+  // Uppercase words are added to the lexicon (in lowercase), but are not
+  // checked
+  ifstream bron( inpname );
+  UnicodeString uline;
+  while ( TiCC::getline(bron, uline ) ){
+    vector<UnicodeString> parts = TiCC::split_at_first_of( uline, " \t" );
+    int num = int(parts.size());
+    if ( num != 3 ){
+      if ( entries ){
+	entries->push_back( lemma_entry{ uline, true } );
+      }
+      else {
+	cerr << "Problem in line '" << uline << "' (to short?)" << endl;
+      }
+      continue;
+    }
+    UnicodeString word = parts[0];
+    UnicodeString ls = word;
+    ls.toLower();
+    if ( lemmas ){
+      lemmas->push_back( TiCC::UnicodeToUTF8( ls ) );
+    }
+    if ( entries && word == ls ){
+      entries->push_back( lemma_entry{ word, false } );
+    }
+  }
+}
+
+void add_known_lemmas( vector<string>& words ){
+  size_t count = words.size();
+  add_words( "sonar.lemmas", words );
+  cout<< "added " << words.size() - count << " words from sonar.lemmas" << endl;
+  count = words.size();
+  add_words( "known.lemmas", words );
+  cout<< "added " << words.size() - count << " words from known.lemmas" << endl;
+}
+
+void check_entry( Mblem& myMblem,
+		  const compiled_lexicon& lexicon,
+		  const lemma_entry& entry,
+		  ostream& out ){
+  if ( entry.problem ){
+    out << "Problem in line '" << entry.text << "' (to short?)\n";
+    return;
+  }
+  const UnicodeString& word = entry.text;
+  myMblem.Classify( word );
+#define LONG
+#ifdef LONG
+  string bytes; // a lemma in UTF-8, to look it up
+  vector<pair<UnicodeString,UnicodeString> > res = myMblem.getResult();
+  for ( auto const& r : res ){
+    UnicodeString lem = r.first;
+    lem.toLower();
+    if ( lem != word
+	 && !isException( lem ) ){
+      bytes.clear();
+      lem.toUTF8String( bytes );
+      if ( !lexicon.contains( bytes ) ){
+	out << word << " ==> " << lem << "\n";
+      }
+    }
+  }
+#endif
+}
+
+void check_entries( const vector<Mblem*>& lemmatizers,
+		    const compiled_lexicon& lexicon,
+		    const vector<lemma_entry>& entries ){
+  // check the entries with a worker per lemmatizer, in batches. The
+  // reports of a batch are collected, and printed in the order of the
+  // input
+  typedef pair<size_t,size_t> entry_range;
+  const size_t batch_size = 100;
+  size_t next = 0;
+  auto next_batch = [&]( entry_range& range ){
+    if ( next == entries.size() ){
+      return false;
+    }
+    range.first = next;
+    next = min( next + batch_size, entries.size() );
+    range.second = next;
+    return true;
+  };
+  auto check_batch = [&]( size_t id, entry_range& range ){
+    ostringstream out;
+    for ( size_t i=range.first; i < range.second; ++i ){
+      check_entry( *lemmatizers[id], lexicon, entries[i], out );
+    }
+    return out.str();
+  };
+  auto print_batch = [&]( string& reports ){
+    cerr << reports;
+  };
+  ordered_pipeline<entry_range,string> pipeline( lemmatizers.size(),
+						 4*lemmatizers.size() );
+  pipeline.run( next_batch, check_batch, print_batch );
+}
+
+bool open_compiled( compiled_lexicon& lex, const string& name ){
+  // use the compiled lexicon 'name', when it is there and up to date
+  if ( !ifstream( name ) ){
+    return false;
+  }
+  if ( !lex.open( name ) ){
+    return false;
+  }
+  if ( lex.is_stale() ){
+    cerr << "WARNING: " << name << " is out of date, use --compile again"
+	 << endl;
+    lex.close();
+    return false;
+  }
+  cout << "using the compiled lexicon: " << name << endl;
+  return true;
+}
+
 int main(int argc, char * const argv[] ) {
-  TiCC::CL_Options opts("i:","");
+  TiCC::CL_Options opts("i:","compile,threads:");
   try {
     opts.parse_args( argc, argv );
   }
@@ -74,90 +228,64 @@ int main(int argc, char * const argv[] ) {
   }
   string inpname = "mblem.lex";
   opts.extract( 'i', inpname );
+  bool compile = opts.extract( "compile" );
+  int num_threads = 1;
+  string value;
+  if ( opts.extract( "threads", value ) ){
+    if ( !TiCC::stringTo( value, num_threads )
+	 || num_threads < 1 ){
+      cerr << "illegal value for --threads (" << value << ")" << endl;
+      return EXIT_FAILURE;
+    }
+  }
   ifstream bron( inpname );
   if ( !bron ){
     cerr << "could not open input file '" << inpname << "'" << endl;
     return EXIT_FAILURE;
   }
-
-  set<UnicodeString> lexicon;
-  cout << "building a lexicon from " << inpname << endl;
-  UnicodeString uline;
-  while ( TiCC::getline(bron, uline ) ){
-    vector<UnicodeString> parts = TiCC::split_at_first_of( uline, " \t" );
-    int num = int(parts.size());
-    if ( num != 3 ){
-      cerr << "Problem in line '" << uline << "' (to short?)" << endl;
-      continue;
-    }
-    UnicodeString word = parts[0];
-    word.toLower();
-    lexicon.insert( word );
-  }
-  cout << "found " << lexicon.size() << " words " << endl;
   bron.close();
-  unsigned int count = 0;
-  bron.open( "sonar.lemmas" );
-  while ( TiCC::getline(bron, uline ) ){
-    if ( uline.isEmpty() ){
-      continue;
-    }
-    ++count;
-    vector<UnicodeString> vec = TiCC::split( uline );
-    lexicon.insert( vec[0] );
+  const string lemma_index = inpname + ".lemmas.idx";
+  compiled_lexicon lexicon;
+  const bool have_compiled = !compile
+    && open_compiled( lexicon, lemma_index );
+  vector<string> words;
+  vector<lemma_entry> entries;
+  cout << "reading " << inpname << endl;
+  read_input( inpname,
+	      have_compiled ? 0 : &words,
+	      compile ? 0 : &entries );
+  if ( !have_compiled ){
+    cout << "found " << words.size() << " words " << endl;
+    add_known_lemmas( words );
   }
-  bron.close();
-  cout<< "added " << count << " words from sonar.lemmas" << endl;
-  count = 0;
-  bron.open( "known.lemmas" );
-  while ( TiCC::getline(bron, uline ) ){
-    if ( uline.isEmpty() ){
-      continue;
+  if ( compile ){
+    if ( !compiled_lexicon::compile( words,
+				     { inpname, "sonar.lemmas", "known.lemmas" },
+				     lemma_index ) ){
+      return EXIT_FAILURE;
     }
-    ++count;
-    vector<UnicodeString> vec = TiCC::split( uline );
-    lexicon.insert( vec[0] );
+    return EXIT_SUCCESS;
   }
-  cout<< "added " << count << " words from known.lemmas" << endl;
-  bron.close();
-  Mblem myMblem(theErrLog);
+  if ( !have_compiled ){
+    lexicon.build( words );
+    words.clear();
+  }
+  cout << "the lexicon has " << lexicon.size() << " words " << endl;
   if ( !configuration.fill( configFileName ) ){
     cerr << "FAILED" << endl;
     exit( EXIT_FAILURE);
   }
-  myMblem.init( configuration );
-  bron.open( inpname );
+  vector<Mblem*> lemmatizers;
+  for ( int i=0; i < num_threads; ++i ){
+    // every thread needs an Mblem of its own. The lexicon is shared
+    Mblem *lemmatizer = new Mblem( new TiCC::LogStream(cerr) );
+    lemmatizer->init( configuration );
+    lemmatizers.push_back( lemmatizer );
+  }
   cout << "checking the lemmas in " << inpname << endl;
-  while ( TiCC::getline(bron, uline ) ){
-    vector<UnicodeString> parts = TiCC::split_at_first_of( uline, " \t" );
-    int num = parts.size();
-    if ( num != 3 ){
-      cerr << "Problem in line '" << uline << "' (to short?)" << endl;
-      continue;
-    }
-    UnicodeString word = parts[0];
-    UnicodeString us = word;
-    UnicodeString ls = us;
-    ls.toLower();
-    if ( us != ls ){
-      // skip uppercases stuff
-      continue;
-    }
-    myMblem.Classify( ls );
-#define LONG
-#ifdef LONG
-    vector<pair<UnicodeString,UnicodeString> > res = myMblem.getResult();
-    for ( auto const& r : res ){
-      UnicodeString lem = r.first;
-      lem.toLower();
-      if ( lem != us
-	   && !isException( lem ) ){
-	if ( lexicon.find(lem) == lexicon.end() ){
-	  cerr << word << " ==> " << lem << endl;
-	}
-      }
-    }
-#endif
+  check_entries( lemmatizers, lexicon, entries );
+  for ( const auto& lemmatizer : lemmatizers ){
+    delete lemmatizer;
   }
   return 0;
 }
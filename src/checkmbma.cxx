@@ -32,6 +32,12 @@
 #include<map>
 #include<string>
 #include<cstdlib>
+#include<sstream>
+#include<functional>
+#include<queue>
+#include<algorithm>
+#include<chrono>
+#include<iomanip>
 #include "timbl/TimblAPI.h"
 #include "ticcutils/StringOps.h"
 #include "ticcutils/PrettyPrint.h"
@@ -44,6 +50,8 @@
 #include "ucto/tokenize.h"
 #include "frog/FrogAPI.h"
 #include "frog/mbma_mod.h"
+#include "toad/ordered_pipeline.h"
+#include "toad/compiled_lexicon.h"
 
 using namespace std;
 using namespace	icu;
@@ -54,10 +62,8 @@ TiCC::Configuration configuration;
 static string configDir = string(SYSCONF_PATH) + "/frog/nld/";
 static string configFileName = configDir + "frog.cfg";
 
-Mbma myMbma(theErrLog);
-
-set<UnicodeString> lexicon;
-set<UnicodeString> mor_lexicon;
+compiled_lexicon lexicon;
+compiled_lexicon mor_lexicon;
 
 bool isException( const string& s ){
   if ( s.size() < 2 )
@@ -69,9 +75,30 @@ void usage(){
   cerr << "checkmbma [-h] [-m] [-S<limit>]" << endl;
   cerr << "check mbma-merged.lex for inconsistencies" << endl;
   cerr << "\t -m signal unknow morphemes too. (a lot!) " << endl;
+  cerr << "\t --threads <n> check with 'n' threads, each with its own Mbma."
+       << endl
+       << "\t\t The reports are in the same order as with 1 thread."
+       << endl;
+  cerr << "\t --top <k> check only the k most frequent words of sonar.words,"
+       << endl
+       << "\t\t the most frequent first. (with -S, only those above the"
+       << " limit)" << endl;
+  cerr << "\t --budget <s> like --top, but stop checking after 's' seconds."
+       << endl
+       << "\t\t Both report the part of all tokens in sonar.words that is"
+       << " checked." << endl;
+  cerr << "\t --compile store the lexicons of known lemmas and morphemes in"
+       << endl
+       << "\t\t mbma-merged.lex.lemmas.idx and known.morphs.idx, and stop."
+       << endl
+       << "\t\t Later runs load those, instead of building the lexicons."
+       << endl;
 }
 
-void check_word( const UnicodeString& _word, bool doMor ){
+void check_word( Mbma& myMbma,
+		 const UnicodeString& _word,
+		 bool doMor,
+		 ostream& out ){
   UnicodeString uword = _word;
   UnicodeString ls = uword;
   ls.toLower();
@@ -81,6 +108,7 @@ void check_word( const UnicodeString& _word, bool doMor ){
   myMbma.Classify( ls, "" );
   vector<pair<UnicodeString,string>> anas = myMbma.getResults(true);
   set<UnicodeString> fails;
+  string bytes; // a morpheme in UTF-8, to look it up
   for ( const auto& ana : anas ){
     UnicodeString flat = flatten(ana.first);
     bool lem_found = false;
@@ -89,18 +117,20 @@ void check_word( const UnicodeString& _word, bool doMor ){
     for ( const auto& mor : mors ){
       UnicodeString mor1 = mor;
       mor1.toLower();
+      bytes.clear();
+      mor1.toUTF8String( bytes );
       if ( mor1 == uword ){
 	lem_found = true;
 	break;
       }
-      else if ( lexicon.find(mor1) != lexicon.end() ){
+      else if ( lexicon.contains( bytes ) ){
 	//	  cerr << "found lemma " << mor1 << endl;
 	lem_found = true;
       }
       else if ( doMor
 		&& mor1.length() != 1
 		&& !first
-		&& mor_lexicon.find(mor1) == mor_lexicon.end() ){
+		&& !mor_lexicon.contains( bytes ) ){
 	//	  cerr << "NOT found mor " << mor << endl;
 	fails.insert(mor1);
       }
@@ -108,17 +138,174 @@ void check_word( const UnicodeString& _word, bool doMor ){
     }
     if ( !lem_found ){
       using TiCC::operator<<;
-      cerr << "UNK LEMMA " << _word << " - " << ana << endl;
+      out << "UNK LEMMA " << _word << " - " << ana << "\n";
     }
     else if ( fails.size() > 0 ){
       using TiCC::operator<<;
-      cerr << "UNK MOR ";
+      out << "UNK MOR ";
       for ( const auto& f : fails ){
-	cerr << "[" << f << "] ";
+	out << "[" << f << "] ";
       }
-      cerr << _word << " - " << ana << endl;
+      out << _word << " - " << ana << "\n";
+    }
+  }
+}
+
+void check_words( const vector<Mbma*>& analysers,
+		  const function<bool(UnicodeString&)>& next_word,
+		  bool doMor,
+		  size_t batch_size = 100 ){
+  // check all words that next_word() gives, with a worker per analyser.
+  // The reports of a batch of words are collected, and printed in the
+  // order of the input.
+  // The words are read ahead, at most 4 batches per worker.
+  typedef vector<UnicodeString> word_batch;
+  auto read_batch = [&]( word_batch& batch ){
+    UnicodeString word;
+    while ( batch.size() < batch_size && next_word( word ) ){
+      batch.push_back( word );
+    }
+    return !batch.empty();
+  };
+  auto check_batch = [&]( size_t id, word_batch& batch ){
+    ostringstream out;
+    for ( const auto& word : batch ){
+      check_word( *analysers[id], word, doMor, out );
+    }
+    return out.str();
+  };
+  auto print_batch = [&]( string& reports ){
+    cerr << reports;
+  };
+  ordered_pipeline<word_batch,string> pipeline( analysers.size(),
+						4*analysers.size() );
+  pipeline.run( read_batch, check_batch, print_batch );
+}
+
+void add_words( const string& filename, vector<string>& words ){
+  // add the first word of every line of 'filename', if it exists
+  ifstream is( filename );
+  UnicodeString uline;
+  while ( TiCC::getline( is, uline ) ){
+    if ( uline.isEmpty() ){
+      continue;
+    }
+    vector<UnicodeString> vec = TiCC::split( uline );
+    if ( !vec.empty() ){
+      words.push_back( TiCC::UnicodeToUTF8( vec[0] ) );
+    }
+  }
+}
+
+void read_lemmas( const string& lexname, vector<string>& words ){
+  ifstream bron( lexname );
+  cout << "building a lexicon from " << lexname << endl;
+  UnicodeString uline;
+  while ( TiCC::getline( bron, uline ) ){
+    vector<UnicodeString> parts = TiCC::split_at( uline, " " );
+    if ( parts.size() < 2 ){
+      cerr << "Problem in line '" << uline << "' (to short?)" << endl;
+      continue;
     }
+    UnicodeString word = parts[0];
+    word.toLower();
+    int num = (int)parts.size()-1;
+    if ( word.length() != num ){
+      cerr << "Problem in line '" << uline << "' (" << word.length()
+	   << " letters, but got " << num << " morphemes)" << endl;
+      continue;
+    }
+    words.push_back( TiCC::UnicodeToUTF8( word ) );
+  }
+  cout << "found " << words.size() << " words " << endl;
+  size_t count = words.size();
+  add_words( "sonar.lemmas", words );
+  cout << "added " << words.size() - count << " sonar lemmas" << endl;
+  count = words.size();
+  add_words( "known.lemmas", words );
+  cout << "added " << words.size() - count << " known lemmas" << endl;
+}
+
+struct ranked_word {
+  UnicodeString word;
+  size_t freq;
+  size_t line;  // to keep the order of words with the same frequency
+};
+
+bool more_frequent( const ranked_word& a, const ranked_word& b ){
+  if ( a.freq != b.freq ){
+    return a.freq > b.freq;
+  }
+  return a.line < b.line;
+}
+
+uint64_t read_ranked( size_t limit,
+		      size_t top,
+		      vector<ranked_word>& words ){
+  // read sonar.words, and keep the 'top' most frequent words with a
+  // frequency above 'limit' (all of them when 'top' is 0), the most
+  // frequent first. Only those are kept in memory, in a heap with the
+  // least frequent one on top.
+  // returns the total frequency of all words in the file
+  priority_queue<ranked_word,
+		 vector<ranked_word>,
+		 decltype(&more_frequent)> heap( &more_frequent );
+  uint64_t tokens = 0;
+  size_t line = 0;
+  ifstream bron( "sonar.words" );
+  UnicodeString uline;
+  while ( TiCC::getline(bron, uline ) ){
+    ++line;
+    if ( uline.isEmpty() ){
+      continue;
+    }
+    vector<UnicodeString> vec = TiCC::split( uline );
+    if ( vec.size() == 4 ){
+      size_t freq;
+      if ( !TiCC::stringTo<size_t>( TiCC::UnicodeToUTF8(vec[1]), freq ) ){
+	cerr << "illegal int in " << uline << endl;
+	continue;
+      }
+      tokens += freq;
+      if ( freq <= limit ){
+	continue;
+      }
+      if ( top > 0 && heap.size() == top ){
+	if ( freq <= heap.top().freq ){
+	  // not more frequent than the least frequent we keep
+	  continue;
+	}
+	heap.pop();
+      }
+      heap.push( ranked_word{ vec[0], freq, line } );
+    }
+  }
+  words.clear();
+  words.reserve( heap.size() );
+  while ( !heap.empty() ){
+    words.push_back( heap.top() );
+    heap.pop();
+  }
+  reverse( words.begin(), words.end() );
+  return tokens;
+}
+
+bool open_compiled( compiled_lexicon& lex, const string& name ){
+  // use the compiled lexicon 'name', when it is there and up to date
+  if ( !ifstream( name ) ){
+    return false;
   }
+  if ( !lex.open( name ) ){
+    return false;
+  }
+  if ( lex.is_stale() ){
+    cerr << "WARNING: " << name << " is out of date, use --compile again"
+	 << endl;
+    lex.close();
+    return false;
+  }
+  cout << "using the compiled lexicon: " << name << endl;
+  return true;
 }
 
 int main(int argc, char * const argv[] ) {
@@ -128,8 +315,20 @@ int main(int argc, char * const argv[] ) {
   bool testSonar = false;
   string debug;
   size_t limit = 0;
+  int num_threads = 1;
+  bool compile = false;
+  size_t top = 0;
+  double budget = 0;
+  static struct option long_options[] = {
+    { "threads", required_argument, 0, 'T' },
+    { "compile", no_argument, 0, 'C' },
+    { "top", required_argument, 0, 'K' },
+    { "budget", required_argument, 0, 'B' },
+    { 0, 0, 0, 0 }
+  };
   int opt;
-  while ( (opt = getopt( argc, argv, "d:hmS:t:")) != -1 ){
+  while ( (opt = getopt_long( argc, argv, "d:hmS:t:",
+			      long_options, 0 )) != -1 ){
     switch ( opt ){
     case 'm': doMor = true; break;
     case 'd':
@@ -142,6 +341,28 @@ int main(int argc, char * const argv[] ) {
     case 't':
       inpname = optarg;
       break;
+    case 'T':
+      if ( !TiCC::stringTo( optarg, num_threads )
+	   || num_threads < 1 ){
+	cerr << "illegal value for --threads (" << optarg << ")" << endl;
+	return EXIT_FAILURE;
+      }
+      break;
+    case 'C':
+      compile = true;
+      break;
+    case 'K':
+      if ( !TiCC::stringTo( optarg, top ) || top == 0 ){
+	cerr << "illegal value for --top (" << optarg << ")" << endl;
+	return EXIT_FAILURE;
+      }
+      break;
+    case 'B':
+      if ( !TiCC::stringTo( optarg, budget ) || budget <= 0 ){
+	cerr << "illegal value for --budget (" << optarg << ")" << endl;
+	return EXIT_FAILURE;
+      }
+      break;
     case 'h': usage(); return EXIT_SUCCESS; break;
     default: usage(); return EXIT_FAILURE;
     }
@@ -152,60 +373,48 @@ int main(int argc, char * const argv[] ) {
     cerr << "could not open mbma file '" << lexname << "'" << endl;
     return EXIT_FAILURE;
   }
-
-  map<UnicodeString,size_t> test_lex;
-  cout << "building a lexicon from " << lexname << endl;
-  UnicodeString uline;
-  while ( TiCC::getline( bron, uline ) ){
-    vector<UnicodeString> parts = TiCC::split_at( uline, " " );
-    if ( parts.size() < 2 ){
-      cerr << "Problem in line '" << uline << "' (to short?)" << endl;
-      continue;
-    }
-    UnicodeString word = parts[0];
-    word.toLower();
-    int num = (int)parts.size()-1;
-    if ( word.length() != num ){
-      cerr << "Problem in line '" << uline << "' (" << word.length()
-	   << " letters, but got " << num << " morphemes)" << endl;
-      continue;
-    }
-    lexicon.insert( word );
-  }
-  cout << "found " << lexicon.size() << " words " << endl;
   bron.close();
-  bron.open( "sonar.lemmas" );
-  while ( TiCC::getline(bron, uline ) ){
-    if ( uline.isEmpty() ) {
-      continue;
+
+  const string lemma_index = lexname + ".lemmas.idx";
+  const string morph_index = "known.morphs.idx";
+  if ( compile ){
+    vector<string> words;
+    read_lemmas( lexname, words );
+    vector<string> morphs;
+    add_words( "known.morphs", morphs );
+    if ( !compiled_lexicon::compile( words,
+				     { lexname, "sonar.lemmas", "known.lemmas" },
+				     lemma_index )
+	 || !compiled_lexicon::compile( morphs,
+					{ "known.morphs" },
+					morph_index ) ){
+      return EXIT_FAILURE;
     }
-    vector<UnicodeString> vec = TiCC::split( uline );
-    lexicon.insert( vec[0] );
+    return EXIT_SUCCESS;
   }
-  bron.close();
-  cout << "added sonar lemmas, size is now: " << lexicon.size() << " words " << endl;
-  bron.open( "known.lemmas" );
-  while ( TiCC::getline(bron, uline ) ){
-    if ( uline.isEmpty() ){
-      continue;
-    }
-    vector<UnicodeString> vec = TiCC::split( uline );
-    lexicon.insert( vec[0] );
+  if ( !open_compiled( lexicon, lemma_index ) ){
+    vector<string> words;
+    read_lemmas( lexname, words );
+    lexicon.build( words );
   }
-  bron.close();
-  cout << "added known lemmas, size is now: " << lexicon.size() << " words " << endl;
-  bron.open( "known.morphs" );
-  while ( TiCC::getline(bron, uline ) ){
-    if ( uline.isEmpty() ){
-      continue;
-    }
-    vector<UnicodeString> vec = TiCC::split( uline );
-    mor_lexicon.insert( vec[0] );
+  cout << "the lexicon has " << lexicon.size() << " words " << endl;
+  if ( !open_compiled( mor_lexicon, morph_index ) ){
+    vector<string> morphs;
+    add_words( "known.morphs", morphs );
+    mor_lexicon.build( morphs );
   }
-  bron.close();
   cout << "found " << mor_lexicon.size() << " known morphemes." << endl;
-  bron.close();
-  if ( testSonar ){
+  const bool ranked = top > 0 || budget > 0;
+  map<UnicodeString,size_t> test_lex;
+  vector<ranked_word> ranked_words;
+  uint64_t total_tokens = 0;
+  UnicodeString uline;
+  if ( ranked ){
+    total_tokens = read_ranked( limit, top, ranked_words );
+    cout << "kept the " << ranked_words.size()
+	 << " most frequent test words from sonar.words" << endl;
+  }
+  else if ( testSonar ){
     bron.open( "sonar.words" );
     while ( TiCC::getline(bron, uline ) ){
       if ( uline.isEmpty() ){
@@ -231,28 +440,104 @@ int main(int argc, char * const argv[] ) {
   if ( !debug.empty() ){
     configuration.setatt( "debug", debug, "mbma" );
   }
-  myMbma.init( configuration );
-  if ( testSonar ){
-    cout << "checking the morphemes in sonar.lemmas " << endl;
-    for ( const auto& it : test_lex ){
-      check_word( it.first, doMor );
+  vector<Mbma*> analysers;
+  for ( int i=0; i < num_threads; ++i ){
+    // every thread needs an Mbma of its own. The lexicons are shared
+    Mbma *analyser = new Mbma( new TiCC::LogStream(cerr) );
+    analyser->init( configuration );
+    analysers.push_back( analyser );
+  }
+  if ( ranked ){
+    cout << "checking the morphemes of the most frequent words in sonar.words"
+	 << endl;
+    auto start = chrono::steady_clock::now();
+    auto elapsed = [&](){
+      return chrono::duration<double>( chrono::steady_clock::now()
+				       - start ).count();
+    };
+    size_t next = 0;
+    uint64_t checked_tokens = 0;
+    bool out_of_time = false;
+    check_words( analysers,
+		 [&]( UnicodeString& word ){
+		   if ( next == ranked_words.size() ){
+		     return false;
+		   }
+		   if ( budget > 0 && elapsed() > budget ){
+		     out_of_time = true;
+		     return false;
+		   }
+		   word = ranked_words[next].word;
+		   checked_tokens += ranked_words[next].freq;
+		   ++next;
+		   return true;
+		 },
+		 doMor,
+		 // smaller batches, so less is read ahead when time is up
+		 budget > 0 ? 10 : 100 );
+    if ( out_of_time ){
+      cout << "stopped after the time budget of " << budget << " seconds"
+	   << endl;
+    }
+    cout << "checked " << next << " of " << ranked_words.size()
+	 << " words in " << elapsed() << " seconds, covering "
+	 << checked_tokens << " of " << total_tokens << " tokens";
+    if ( total_tokens > 0 ){
+      ostringstream percent; // keep the format flags of cout as they are
+      percent << fixed << setprecision(2)
+	      << 100.0 * checked_tokens / total_tokens;
+      cout << " (" << percent.str() << "%)";
     }
+    cout << endl;
+  }
+  else if ( testSonar ){
+    cout << "checking the morphemes in sonar.lemmas " << endl;
+    auto it = test_lex.begin();
+    check_words( analysers,
+		 [&]( UnicodeString& word ){
+		   if ( it == test_lex.end() ){
+		     return false;
+		   }
+		   word = it->first;
+		   ++it;
+		   return true;
+		 },
+		 doMor );
   }
   else if ( !inpname.empty() ){
     bron.open( inpname );
     cout << "checking the morphemes in " << inpname << endl;
-    while ( TiCC::getline(bron, uline ) ){
-      vector<UnicodeString> parts = TiCC::split( uline );
-      check_word( parts[0], doMor );
-    }
+    check_words( analysers,
+		 [&]( UnicodeString& word ){
+		   while ( TiCC::getline(bron, uline ) ){
+		     vector<UnicodeString> parts = TiCC::split( uline );
+		     if ( !parts.empty() ){
+		       word = parts[0];
+		       return true;
+		     }
+		   }
+		   return false;
+		 },
+		 doMor );
   }
   else {
     bron.open( lexname );
     cout << "checking the morphemes in " << lexname << endl;
-    while ( TiCC::getline(bron, uline ) ){
-      vector<UnicodeString> parts = TiCC::split_at( uline, " " );
-      check_word( parts[0], doMor );
-    }
+    check_words( analysers,
+		 [&]( UnicodeString& word ){
+		   while ( TiCC::getline(bron, uline ) ){
+		     vector<UnicodeString> parts = TiCC::split_at( uline, " " );
+		     if ( !parts.empty() ){
+		       word = parts[0];
+		       return true;
+		     }
+		   }
+		   return false;
+		 },
+		 doMor );
+  }
+  for ( const auto& analyser : analysers ){
+    delete analyser;
   }
   return 0;
 }
@@ -29,6 +29,7 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <sstream>
 #include "ticcutils/StringOps.h"
 #include "ticcutils/CommandLine.h"
 #include "ticcutils/FileUtils.h"
@@ -39,6 +40,11 @@
 #include "ucto/tokenize.h"
 #include "unicode/ustream.h"
 #include "unicode/unistr.h"
+#include "toad/stage_timer.h"
+#include "toad/output_writer.h"
+#include "toad/tag_cache.h"
+#include "toad/ordered_pipeline.h"
+#include "toad/feature_window.h"
 #include "config.h"
 
 using namespace std;
@@ -49,6 +55,14 @@ LogStream mylog(cerr);
 
 string EOS_MARK = "\n";
 
+string timings_file;
+int num_threads = 1;
+bool report_progress = false;
+progress_meter progress;
+stage_timer timings;
+static tag_cache tagging_cache;
+static feature_window window( 1, 1 );
+
 static Configuration use_config;
 static Configuration default_config;
 
@@ -64,6 +78,8 @@ void set_default_config(){
 		    "+vS -G -FColumns K: -a4 -mM -k5 -dID U: -a0 -mM -k19 -dID",
 		    "IOB" );
   default_config.setatt( "set", "http://ilk.uvt.nl/folia/sets/frog-chunker-nl", "IOB" );
+  default_config.setatt( "left_context", "1", "IOB" );
+  default_config.setatt( "right_context", "1", "IOB" );
 }
 
 class setting_error: public std::runtime_error {
@@ -82,88 +98,226 @@ void usage( const string& name ){
        << endl;
   cerr << "-c 'configfile'\t An existing configfile that will be enriched\n"
        << "\t\t with additional NER specific information." << endl;
+  cerr << "\t\t Its left_context and right_context keys in [[IOB]] set the\n"
+       << "\t\t context window (default 1 and 1). Frog can only use a model\n"
+       << "\t\t with other widths when it is configured with the same ones."
+       << endl;
   cerr << "-O 'outputdir'\t The directoy where all the outputfiles are stored\n"
        << "\t\t highly recommended to use, because a lot of files are created\n"
        << "\t\t and your working directory will get cluttered." << endl;
   cerr << "-b 'name' use 'name' as the label in the configfile." << endl;
   cerr << "-X keep intermediate files." << endl;
+  cerr << "--threads 'n' use 'n' threads, each with its own POS tagger, to"
+       << " enrich the\n"
+       << "\t\t corpus. The output is the same as with 1 thread. (default 1)"
+       << endl;
+  cerr << "--tag-cache 'file' keep the POS tags of all sentences in 'file',\n"
+       << "\t\t and only tag sentences that are not in there yet. The cache\n"
+       << "\t\t can be shared with nergen." << endl;
+  cerr << "--stats report the progress every 10 seconds, instead of dots,"
+       << " and print\n"
+       << "\t\t the JSON summary of --timings at the end, when no 'file' is\n"
+       << "\t\t given for it." << endl;
+  cerr << "--timings 'file' write the time spent in every stage, the counts,"
+       << " rates and\n"
+       << "\t\t memory use to 'file', in JSON." << endl;
   cerr << "-V or --version Show version information" << endl;
   cerr << "-h or --help Display this information." << endl;
 }
 
 
-void spit_out( ostream& os,
-	       const vector<Tagger::TagResult>& tagv,
-	       const vector<UnicodeString>& chunk_file_tags ){
-  vector<UnicodeString> words;
-  vector<UnicodeString> tags;
+void tag_sentence( MbtAPI *tagger,
+		   const UnicodeString& blob,
+		   vector<UnicodeString>& words,
+		   vector<UnicodeString>& tags ){
+  // POS tag the sentence, unless the result is in the cache
+  if ( tagging_cache.lookup( blob, words, tags ) ){
+    return;
+  }
+  vector<Tagger::TagResult> tagv = tagger->TagLine( blob );
   for( const auto& tr : tagv ){
     words.push_back( tr.word() );
     tags.push_back( tr.assigned_tag() );
   }
-  UnicodeString prevP = "_";
+  tagging_cache.store( blob, words, tags );
+}
+
+void spit_out( output_writer& os,
+	       const vector<UnicodeString>& words,
+	       const vector<UnicodeString>& tags,
+	       const vector<UnicodeString>& chunk_file_tags ){
   for ( size_t i=0; i < words.size(); ++i ){
-    UnicodeString line = words[i] + "\t" + prevP + "\t" + tags[i] + "\t";
-    prevP = tags[i];
-    if ( i < words.size() - 1 ){
-      line += tags[i+1] + "\t";
-    }
-    else {
-      line += "_\t";
-    }
-    line += chunk_file_tags[i];
-    os << line << endl;
+    os << words[i] << "\t";
+    window.write( os, "\t", i, tags );
+    os << chunk_file_tags[i] << "\n";
   }
 }
 
-void create_train_file( MbtAPI *MyTagger,
-			const string& inpname,
-			const string& outname ){
-  ofstream os( outname );
+struct chunk_sentence {
+  UnicodeString blob;                    // the words, one per line
+  vector<UnicodeString> chunk_file_tags; // the tags as specified in the input
+  string eos_mark;                       // the EOS_MARK in effect after it
+  bool counted = true;                   // not the last, unterminated one
+  uint64_t bytes = 0;                    // the size of its input lines
+};
+
+using chunk_batch = vector<chunk_sentence>;
+
+struct chunk_output {
+  string text;            // the instances for a batch
+  size_t counted = 0;     // the number of sentences for the progress dots
+  size_t sentences = 0;
+  uint64_t bytes = 0;     // the size of the input of the batch
+};
+
+size_t create_train_file( const vector<MbtAPI*>& taggers,
+			  const string& inpname,
+			  const string& outname ){
+  // POS tag the sentences of the IOB file, and create the instances.
+  // With more taggers, batches of sentences are handled by a pool of
+  // workers, each with its own tagger. The results are written in the
+  // original order, so the output is the same as with 1 tagger.
+  output_writer os( outname, true );
+  if ( !os ){
+    cerr << "could not open output file '" << outname << "'" << endl;
+    exit(EXIT_FAILURE);
+  }
   ifstream is( inpname );
-  string line;
-  UnicodeString blob;
-  vector<UnicodeString> chunk_tags;
-  size_t HeartBeat = 0;
-  while ( getline( is, line ) ){
-    if ( line == "<utt>" ){
-      EOS_MARK = "<utt>";
-      line.clear();
+  const size_t batch_size = 100;
+  size_t tokens = 0;
+  size_t lines = 0;
+  uint64_t bytes_read = 0;
+  string bad_line;
+  // these run in the reader, the workers and the writer of the pipeline,
+  // next to each other
+  stopwatch parsing( stopwatch::THREAD );
+  stopwatch writing( stopwatch::THREAD );
+  vector<stopwatch> tagging( taggers.size(), stopwatch( stopwatch::THREAD ) );
+  vector<stopwatch> generating( taggers.size(),
+				stopwatch( stopwatch::THREAD ) );
+  auto read_batch = [&]( chunk_batch& batch ){
+    if ( !bad_line.empty() ){
+      return false;
     }
-    if ( line.empty() ) {
-      if ( !blob.isEmpty() ){
-	vector<Tagger::TagResult> tagv = MyTagger->TagLine( blob );
-	spit_out( os, tagv, chunk_tags );
-	os << EOS_MARK << endl;
-	blob.remove();
-	if ( ++HeartBeat % 8000 == 0 ) {
-	  cout << endl;
-	}
-	if ( HeartBeat % 100 == 0 ) {
-	  cout << ".";
-	  cout.flush();
+    parsing.start();
+    chunk_sentence sentence;
+    string line;
+    while ( batch.size() < batch_size
+	    && getline( is, line ) ){
+      ++lines;
+      bytes_read += line.size() + 1;
+      sentence.bytes += line.size() + 1;
+      if ( line == "<utt>" ){
+	EOS_MARK = "<utt>";
+	line.clear();
+      }
+      if ( line.empty() ) {
+	if ( !sentence.blob.isEmpty() ){
+	  sentence.eos_mark = EOS_MARK;
+	  batch.push_back( std::move(sentence) );
+	  sentence = chunk_sentence();
 	}
-	chunk_tags.clear();
+	continue;
       }
-      continue;
+      vector<UnicodeString> parts = TiCC::split( TiCC::UnicodeFromUTF8(line) );
+      if ( parts.size() != 2 ){
+	// stop reading. we bail out after all previous sentences are done
+	bad_line = line;
+	break;
+      }
+      sentence.blob += parts[0] + "\n";
+      sentence.chunk_file_tags.push_back( parts[1] );
+      ++tokens;
     }
-    vector<UnicodeString> parts = TiCC::split( TiCC::UnicodeFromUTF8(line) );
-    if ( parts.size() != 2 ){
-      cerr << "DOOD: " << line << endl;
-      exit(EXIT_FAILURE);
+    if ( !sentence.blob.isEmpty() && bad_line.empty() ){
+      // the last sentence, without a separator
+      sentence.counted = false;
+      batch.push_back( std::move(sentence) );
+    }
+    parsing.stop();
+    return !batch.empty();
+  };
+  auto tag_batch = [&]( size_t id, chunk_batch& batch ){
+    chunk_output result;
+    output_writer buf; // in memory
+    vector<UnicodeString> words;
+    vector<UnicodeString> tags;
+    for ( const auto& sentence : batch ){
+      tagging[id].start();
+      tag_sentence( taggers[id], sentence.blob, words, tags );
+      tagging[id].stop();
+      generating[id].start();
+      spit_out( buf, words, tags, sentence.chunk_file_tags );
+      if ( sentence.counted ){
+	// the last sentence gets no EOS mark
+	buf << sentence.eos_mark << "\n";
+	++result.counted;
+      }
+      generating[id].stop();
+      result.bytes += sentence.bytes;
+    }
+    result.sentences = batch.size();
+    result.text = buf.str();
+    return result;
+  };
+  size_t HeartBeat = 0;
+  size_t sentences = 0;
+  uint64_t bytes_done = 0;
+  auto write_batch = [&]( chunk_output& result ){
+    writing.start();
+    os << result.text;
+    writing.stop();
+    sentences += result.sentences;
+    bytes_done += result.bytes;
+    if ( progress.active() ){
+      progress.update( bytes_done, sentences );
+      return;
+    }
+    for ( size_t i=0; i < result.counted; ++i ){
+      if ( ++HeartBeat % 8000 == 0 ) {
+	cout << endl;
+      }
+      if ( HeartBeat % 100 == 0 ) {
+	cout << ".";
+	cout.flush();
+      }
     }
-    blob += parts[0] + "\n";
-    chunk_tags.push_back( parts[1] );
+  };
+  ordered_pipeline<chunk_batch,chunk_output> pipeline( taggers.size(),
+						       4*taggers.size() );
+  pipeline.run( read_batch, tag_batch, write_batch );
+  if ( !bad_line.empty() ){
+    cerr << "DOOD: " << bad_line << endl;
+    exit(EXIT_FAILURE);
   }
-  if ( !blob.isEmpty() ){
-    vector<Tagger::TagResult> tagv = MyTagger->TagLine( blob );
-    spit_out( os, tagv, chunk_tags );
+  writing.start();
+  if ( !os.close() ){
+    cerr << "writing to '" << outname << "' failed" << endl;
+    exit(EXIT_FAILURE);
   }
-
+  writing.stop();
+  progress.finish( bytes_read, sentences );
+  // with more workers, these are the times summed over all workers
+  stopwatch tag_time;
+  stopwatch generate_time;
+  for ( size_t i=0; i < taggers.size(); ++i ){
+    tag_time += tagging[i];
+    generate_time += generating[i];
+  }
+  timings.add( "parsing", parsing, tokens );
+  timings.add( "tagging", tag_time, tokens );
+  timings.add( "instance generation", generate_time, tokens );
+  timings.add( "writing", writing, tokens );
+  timings.count( "lines", lines );
+  timings.count( "tokens", tokens );
+  timings.count( "sentences", sentences );
+  timings.count( "bytes_read", bytes_read );
+  timings.count( "bytes_written", os.bytes_written() );
+  return tokens;
 }
 
 int main(int argc, char * const argv[] ) {
-  TiCC::CL_Options opts("b:O:c:hVX","version");
+  TiCC::CL_Options opts("b:O:c:hVX","version,timings:,tag-cache:,stats,threads:");
   try {
     opts.parse_args( argc, argv );
   }
@@ -193,6 +347,18 @@ int main(int argc, char * const argv[] ) {
   }
   bool keepX = opts.extract( 'X' );
   opts.extract( 'O', outputdir );
+  opts.extract( "timings", timings_file );
+  report_progress = opts.extract( "stats" );
+  string value;
+  if ( opts.extract( "threads", value ) ){
+    if ( !TiCC::stringTo( value, num_threads )
+	 || num_threads < 1 ){
+      cerr << "illegal value for --threads (" << value << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+  string tag_cache_name;
+  opts.extract( "tag-cache", tag_cache_name );
   if ( !outputdir.empty() ){
     if ( outputdir[outputdir.length()-1] != '/' )
       outputdir += "/";
@@ -209,6 +375,9 @@ int main(int argc, char * const argv[] ) {
     use_config.setatt( "baseName", base_name, "IOB" );
   }
   use_config.merge( default_config ); // to be sure to have all we need
+  if ( !context_window( use_config, "IOB", window ) ){
+    exit( EXIT_FAILURE );
+  }
 
   // first check the validity of the configfile.
   // We are picky. ALL parameters are needed!
@@ -250,12 +419,14 @@ int main(int argc, char * const argv[] ) {
     throw setting_error( "settings", "tagger" );
   }
   string use_dir = use_config.configDir();
+  string mbt_settings_file;
   if ( use_dir.empty() ){
-    mbt_setting = "-s " + outputdir + mbt_setting + " -vcf" ;
+    mbt_settings_file = outputdir + mbt_setting;
   }
   else {
-    mbt_setting = "-s " + use_dir + mbt_setting + " -vcf" ;
+    mbt_settings_file = use_dir + mbt_setting;
   }
+  mbt_setting = "-s " + mbt_settings_file + " -vcf" ;
   vector<string> names = opts.getMassOpts();
   if ( names.size() == 0 ){
     cerr << "missing inputfile" << endl;
@@ -271,18 +442,51 @@ int main(int argc, char * const argv[] ) {
     cerr << "unable to open inputfile '" << names[0] << "'" << endl;
     exit(EXIT_FAILURE);
   }
-  MbtAPI *PosTagger = new MbtAPI( mbt_setting, mylog );
-  if ( !PosTagger->isInit() ){
-    exit( EXIT_FAILURE );
+  vector<MbtAPI*> PosTaggers;
+  for ( int i=0; i < num_threads; ++i ){
+    // every thread needs a tagger of its own
+    MbtAPI *PosTagger = new MbtAPI( mbt_setting, mylog );
+    if ( !PosTagger->isInit() ){
+      exit( EXIT_FAILURE );
+    }
+    PosTaggers.push_back( PosTagger );
+  }
+  if ( !tag_cache_name.empty() ){
+    // the path of the settings is left out, only "-vcf" matters
+    string fingerprint = tag_cache::tagger_fingerprint( mbt_settings_file,
+							 "-vcf" );
+    if ( fingerprint.empty() ){
+      cerr << "unable to read the tagger settings: " << mbt_settings_file
+	   << endl;
+      exit( EXIT_FAILURE );
+    }
+    if ( !tagging_cache.open( tag_cache_name, fingerprint ) ){
+      exit( EXIT_FAILURE );
+    }
+    cout << "using tag cache: " << tag_cache_name << " ("
+	 << tagging_cache.size() << " sentences)" << endl;
   }
   string inpname = names[0];
   string outname = outputdir + base_name + ".data";
   string setting_name = outputdir + base_name + ".settings";
 
-  cout << "Start converting: " << inpname
-       << " (every dot represents 100 tagged sentences)" << endl;
-  create_train_file( PosTagger, inpname, outname );
+  if ( !report_progress ){
+    cout << "Start converting: " << inpname
+	 << " (every dot represents 100 tagged sentences)" << endl;
+  }
+  else {
+    cout << "Start converting: " << inpname << endl;
+    progress.start( "sentences", inpname );
+  }
+  size_t tokens = create_train_file( PosTaggers, inpname, outname );
   cout << endl << "Created a trainingfile: " << outname << endl;
+  if ( tagging_cache.is_open() ){
+    cout << "tag cache: " << tagging_cache.hits() << " hits, "
+	 << tagging_cache.misses() << " misses" << endl;
+    if ( !tagging_cache.save() ){
+      exit( EXIT_FAILURE );
+    }
+  }
 
   string taggercommand = "-E " + outname
     + " -s " + setting_name
@@ -301,7 +505,11 @@ int main(int argc, char * const argv[] ) {
   cout << "start tagger: " << taggercommand << endl;
   cout << "this may take several minutes, depending on the corpus size."
        << endl;
+  stopwatch training;
+  training.start();
   MbtAPI::GenerateTagger( taggercommand );
+  training.stop();
+  timings.add( "training", training, tokens );
   cout << "finished tagger" << endl;
   Configuration frog_config = use_config;
   frog_config.clearatt( "p", "IOB" );
@@ -330,5 +538,15 @@ int main(int argc, char * const argv[] ) {
   }
   frog_config.create_configfile( cfg_out );
   cout << "stored a frog configfile template: " << cfg_out << endl;
+  if ( !timings_file.empty() ){
+    if ( !timings.write_json( timings_file, "chunkgen" ) ){
+      cerr << "unable to write timings to: " << timings_file << endl;
+      return EXIT_FAILURE;
+    }
+    cout << "stored the timings in: " << timings_file << endl;
+  }
+  else if ( report_progress ){
+    timings.write_json( cout, "chunkgen" );
+  }
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,343 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "toad/compiled_lexicon.h"
+
+using namespace std;
+
+static const char MAGIC[8] = { 'T', 'O', 'A', 'D', 'L', 'E', 'X', '1' };
+static const uint32_t ENDIAN_CHECK = 0x01020304;
+static const uint32_t BLOCK_SIZE = 16;
+
+// the layout of the table. All sections start at a multiple of 8.
+// Within the words, a number is stored in 7 bit groups, lowest first, with
+// the high bit set on all but the last byte.
+struct compiled_lexicon::header {
+  char magic[8];
+  uint32_t byte_order;    // to detect a file from another architecture
+  uint32_t block_size;
+  uint64_t count;         // the number of words
+  uint64_t sources;       // lines 'size<tab>mtime<tab>filename'
+  uint64_t sources_size;
+  uint64_t blocks;        // per block, the offset of its first word
+  uint64_t block_count;
+  uint64_t words;         // the front coded words
+  uint64_t words_size;
+};
+
+compiled_lexicon::compiled_lexicon():
+  _data( 0 ),
+  _size( 0 ),
+  _mapped( false ),
+  _header( 0 )
+{
+}
+
+compiled_lexicon::~compiled_lexicon(){
+  close();
+}
+
+void compiled_lexicon::close(){
+  if ( _data && _mapped ){
+    munmap( const_cast<char*>(_data), _size );
+  }
+  _data = 0;
+  _size = 0;
+  _mapped = false;
+  _image.clear();
+  _header = 0;
+}
+
+static void put_number( string& out, uint64_t n ){
+  while ( n >= 0x80 ){
+    out += static_cast<char>( ( n & 0x7F ) | 0x80 );
+    n >>= 7;
+  }
+  out += static_cast<char>( n );
+}
+
+static uint64_t get_number( const unsigned char*& p ){
+  uint64_t n = 0;
+  int shift = 0;
+  while ( *p & 0x80 ){
+    n |= uint64_t( *p & 0x7F ) << shift;
+    shift += 7;
+    ++p;
+  }
+  n |= uint64_t( *p ) << shift;
+  ++p;
+  return n;
+}
+
+static string file_signature( const string& filename ){
+  // the size and modification time, or "-" when there is no such file
+  struct stat st;
+  if ( stat( filename.c_str(), &st ) != 0 ){
+    return "-\t-";
+  }
+  return to_string( st.st_size ) + "\t" + to_string( st.st_mtime );
+}
+
+string compiled_lexicon::make_image( vector<string>& words,
+				    const string& source_block ){
+  sort( words.begin(), words.end() );
+  words.erase( unique( words.begin(), words.end() ), words.end() );
+  string coded;
+  vector<uint64_t> offsets;
+  for ( size_t i=0; i < words.size(); ++i ){
+    const string& word = words[i];
+    if ( i % BLOCK_SIZE == 0 ){
+      offsets.push_back( coded.size() );
+      put_number( coded, word.size() );
+      coded += word;
+    }
+    else {
+      const string& prev = words[i-1];
+      size_t shared = 0;
+      while ( shared < prev.size() && shared < word.size()
+	      && prev[shared] == word[shared] ){
+	++shared;
+      }
+      put_number( coded, shared );
+      put_number( coded, word.size() - shared );
+      coded.append( word, shared, string::npos );
+    }
+  }
+  header h;
+  memset( &h, 0, sizeof(h) );
+  memcpy( h.magic, MAGIC, sizeof(MAGIC) );
+  h.byte_order = ENDIAN_CHECK;
+  h.block_size = BLOCK_SIZE;
+  h.count = words.size();
+  uint64_t pos = sizeof(h);
+  h.sources = pos;
+  h.sources_size = source_block.size();
+  pos += source_block.size();
+  pos += ( 8 - pos % 8 ) % 8;
+  h.blocks = pos;
+  h.block_count = offsets.size();
+  pos += offsets.size() * sizeof(uint64_t);
+  h.words = pos;
+  h.words_size = coded.size();
+  string image;
+  image.reserve( pos + coded.size() );
+  image.append( reinterpret_cast<const char*>(&h), sizeof(h) );
+  image += source_block;
+  image.resize( h.blocks, '\0' );
+  image.append( reinterpret_cast<const char*>(offsets.data()),
+		offsets.size() * sizeof(uint64_t) );
+  image += coded;
+  return image;
+}
+
+bool compiled_lexicon::compile( vector<string>& words,
+				const vector<string>& sources,
+				const string& lexicon_name ){
+  // store the (unique) words in 'lexicon_name'. 'sources' are the files
+  // they were taken from
+  string source_block;
+  for ( const auto& src : sources ){
+    source_block += file_signature( src ) + "\t" + src + "\n";
+  }
+  string image = make_image( words, source_block );
+  // write to a temporary file first
+  string temp_name = lexicon_name + ".tmp";
+  ofstream os( temp_name, ios::binary );
+  if ( !os ){
+    cerr << "unable to create: " << temp_name << endl;
+    return false;
+  }
+  os.write( image.data(), image.size() );
+  os.close();
+  if ( !os ){
+    cerr << "writing " << temp_name << " failed" << endl;
+    return false;
+  }
+  if ( rename( temp_name.c_str(), lexicon_name.c_str() ) != 0 ){
+    cerr << "unable to rename " << temp_name << " to " << lexicon_name
+	 << endl;
+    return false;
+  }
+  cout << "compiled " << words.size() << " words into: " << lexicon_name
+       << endl;
+  return true;
+}
+
+void compiled_lexicon::build( vector<string>& words ){
+  // the same table, in memory
+  close();
+  _image = make_image( words, "" );
+  _data = _image.data();
+  _size = _image.size();
+  _header = reinterpret_cast<const header*>(_data);
+}
+
+bool compiled_lexicon::check_header(){
+  const header& h = *_header;
+  return memcmp( h.magic, MAGIC, sizeof(MAGIC) ) == 0
+    && h.byte_order == ENDIAN_CHECK
+    && h.block_size == BLOCK_SIZE
+    && h.sources + h.sources_size <= _size
+    && h.blocks + h.block_count*sizeof(uint64_t) <= _size
+    && h.words + h.words_size <= _size;
+}
+
+bool compiled_lexicon::open( const string& lexicon_name ){
+  close();
+  int fd = ::open( lexicon_name.c_str(), O_RDONLY );
+  if ( fd < 0 ){
+    cerr << "unable to open lexicon: " << lexicon_name << endl;
+    return false;
+  }
+  struct stat st;
+  if ( fstat( fd, &st ) != 0 || size_t(st.st_size) < sizeof(header) ){
+    ::close( fd );
+    cerr << "invalid lexicon: " << lexicon_name << endl;
+    return false;
+  }
+  void *data = mmap( 0, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+  ::close( fd );
+  if ( data == MAP_FAILED ){
+    cerr << "unable to map lexicon: " << lexicon_name << endl;
+    return false;
+  }
+  _data = static_cast<const char*>(data);
+  _size = st.st_size;
+  _mapped = true;
+  _header = reinterpret_cast<const header*>(_data);
+  if ( !check_header() ){
+    cerr << "invalid or incompatible lexicon: " << lexicon_name << endl;
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool compiled_lexicon::is_stale() const {
+  // true when one of the source files changed since compile()
+  istringstream is( string( _data + _header->sources,
+			    _header->sources_size ) );
+  string line;
+  while ( getline( is, line ) ){
+    size_t pos = line.find( '\t' );
+    pos = line.find( '\t', pos + 1 );
+    if ( pos == string::npos ){
+      return true;
+    }
+    if ( line.substr( 0, pos ) != file_signature( line.substr( pos + 1 ) ) ){
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t compiled_lexicon::size() const {
+  return _header ? _header->count : 0;
+}
+
+bool compiled_lexicon::contains( const char *word, size_t len ) const {
+  if ( !_header || _header->block_count == 0 ){
+    return false;
+  }
+  const header& h = *_header;
+  const uint64_t *blocks = reinterpret_cast<const uint64_t*>(_data + h.blocks);
+  const unsigned char *words =
+    reinterpret_cast<const unsigned char*>(_data + h.words);
+  const unsigned char *key = reinterpret_cast<const unsigned char*>(word);
+  // find the last block that starts with a word before 'word'
+  size_t lo = 0;
+  size_t hi = h.block_count;
+  while ( lo < hi ){
+    size_t mid = lo + ( hi - lo ) / 2;
+    const unsigned char *p = words + blocks[mid];
+    uint64_t first_len = get_number( p );
+    int cmp = memcmp( p, key, min<uint64_t>( first_len, len ) );
+    if ( cmp == 0 ){
+      cmp = ( first_len < len ) ? -1 : ( first_len > len ? 1 : 0 );
+    }
+    if ( cmp == 0 ){
+      return true;
+    }
+    if ( cmp < 0 ){
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  if ( lo == 0 ){
+    return false;
+  }
+  const size_t block = lo - 1;
+  const unsigned char *p = words + blocks[block];
+  const unsigned char *end = words
+    + ( block + 1 < h.block_count ? blocks[block+1] : h.words_size );
+  uint64_t first_len = get_number( p );
+  // 'match' is the length of the common prefix of 'word' and the previous
+  // word in the block, which is smaller than 'word'
+  size_t match = 0;
+  while ( match < first_len && match < len && p[match] == key[match] ){
+    ++match;
+  }
+  p += first_len;
+  while ( p < end ){
+    uint64_t shared = get_number( p );
+    uint64_t rest = get_number( p );
+    const unsigned char *suffix = p;
+    p += rest;
+    if ( shared > match ){
+      // still smaller, in the same position as the previous word
+      continue;
+    }
+    if ( shared < match ){
+      // larger than 'word', so it is not there
+      return false;
+    }
+    size_t i = 0;
+    while ( i < rest && match + i < len && suffix[i] == key[match+i] ){
+      ++i;
+    }
+    if ( match + i == len ){
+      // found, unless 'word' is a prefix of this one
+      return i == rest;
+    }
+    if ( i < rest && suffix[i] > key[match+i] ){
+      return false;
+    }
+    match += i;
+  }
+  return false;
+}
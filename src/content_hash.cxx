@@ -0,0 +1,92 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <cstdio>
+#include <fstream>
+#include "toad/content_hash.h"
+
+using namespace std;
+
+content_hash::content_hash():
+  _hash( 14695981039346656037ULL )
+{
+}
+
+void content_hash::update( const char *s, size_t len ){
+  uint64_t h = _hash;
+  for ( size_t i=0; i < len; ++i ){
+    h ^= static_cast<unsigned char>(s[i]);
+    h *= 1099511628211ULL;
+  }
+  _hash = h;
+}
+
+content_hash& content_hash::add( const char *s, size_t len ){
+  uint64_t prefix = len;
+  char bytes[8];
+  for ( int i=0; i < 8; ++i ){
+    bytes[i] = static_cast<char>( prefix >> (8*i) );
+  }
+  update( bytes, 8 );
+  update( s, len );
+  return *this;
+}
+
+content_hash& content_hash::add( const string& s ){
+  return add( s.data(), s.size() );
+}
+
+bool content_hash::add_file( const string& filename ){
+  // add the contents of the file. returns false when it can't be read.
+  ifstream is( filename, ios::binary );
+  if ( !is ){
+    return false;
+  }
+  static const size_t BLOCK = 1024*1024;
+  string buffer( BLOCK, '\0' );
+  content_hash contents;
+  uint64_t size = 0;
+  while ( is ){
+    is.read( &buffer[0], BLOCK );
+    size_t got = is.gcount();
+    contents.update( buffer.data(), got );
+    size += got;
+  }
+  if ( is.bad() ){
+    return false;
+  }
+  // fold the size and the hash of the contents into this one
+  string summary = to_string( size ) + ":" + contents.hex();
+  add( summary );
+  return true;
+}
+
+string content_hash::hex() const {
+  char buf[17];
+  snprintf( buf, sizeof(buf), "%016llx",
+	    static_cast<unsigned long long>(_hash) );
+  return buf;
+}
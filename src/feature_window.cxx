@@ -0,0 +1,58 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <iostream>
+#include "ticcutils/StringOps.h"
+#include "ticcutils/Configuration.h"
+#include "toad/feature_window.h"
+
+using namespace std;
+
+bool context_window( const TiCC::Configuration& config,
+		     const string& module,
+		     feature_window& window ){
+  size_t left = 0;
+  size_t right = 0;
+  string value = config.lookUp( "left_context", module );
+  if ( !TiCC::stringTo( value, left ) ){
+    cerr << "illegal value for left_context (" << value << ")" << endl;
+    return false;
+  }
+  value = config.lookUp( "right_context", module );
+  if ( !TiCC::stringTo( value, right ) ){
+    cerr << "illegal value for right_context (" << value << ")" << endl;
+    return false;
+  }
+  if ( left != window.left() || right != window.right() ){
+    cerr << "WARNING: using a context window of " << left << " left and "
+	 << right << " right for [[" << module << "]].\n"
+	 << "\t Frog uses " << window.left() << " and " << window.right()
+	 << ", so it can't use this model, unless it is configured with the\n"
+	 << "\t same left_context and right_context." << endl;
+  }
+  window = feature_window( left, right );
+  return true;
+}
@@ -28,9 +28,13 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <algorithm>
 #include <map>
 #include <set>
 #include <string>
+#include <sstream>
+#include <functional>
+#include <future>
 #include "ticcutils/StringOps.h"
 #include "ticcutils/PrettyPrint.h"
 #include "ticcutils/CommandLine.h"
@@ -43,7 +47,16 @@
 #include "ucto/tokenize.h"
 #include "unicode/ustream.h"
 #include "unicode/unistr.h"
+#include "toad/lemma_store.h"
+#include "toad/particle_matcher.h"
+#include "toad/content_hash.h"
+#include "toad/instance_file.h"
+#include "toad/stage_timer.h"
+#include "toad/output_writer.h"
 #include "config.h"
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace	icu;
@@ -52,7 +65,15 @@ using TiCC::operator<<;
 
 int debug = 0;
 const int HISTORY = 20;
+int num_threads = 1;
 bool lemma_file_only = false;
+bool incremental = false;
+bool keep_temp = false;
+string timings_file;
+bool report_progress = false;
+stage_timer timings;
+progress_meter progress;
+size_t corpus_tokens = 0;
 string output_dir="";
 string temp_dir="/tmp/froggen";
 string encoding="UTF-8";
@@ -137,147 +158,343 @@ void usage( const string& name ){
        << "\t This list is again in the right format for training." << endl;
   cerr << "--temp-dir 'dirname' The directory to store teporary files. "
        << "(default: " << temp_dir << " )" << endl;
+  cerr << "--threads 'n' use 'n' threads to read the corpus and lemma files"
+       << " and to create the lemmatizer instances.\n"
+       << "\tThe tagger and the lemmatizer are then trained concurrently."
+       << " (default 1)" << endl;
+  cerr << "--keep-temp keep the lemmatizer instances in a file in the temp-dir."
+       << " Normally\n"
+       << "\tthey are kept in memory." << endl;
+  cerr << "--timings 'file' write the time spent in every stage, the counts,"
+       << " rates and\n"
+       << "\t memory use to 'file', in JSON." << endl;
+  cerr << "--stats report the progress of reading the corpus every 10"
+       << " seconds, and\n"
+       << "\t print the JSON summary of --timings at the end, when no 'file'"
+       << " is given\n"
+       << "\t for it." << endl;
+  cerr << "--incremental only rebuild the tagger and/or the lemmatizer when"
+       << " their input\n"
+       << "\tchanged since the last run with the same 'outputdir'." << endl;
   cerr << "-h or --help These messages." << endl;
   cerr << "-v or --version Give version info." << endl;
 }
 
-using mblem_data = multimap<UnicodeString,map<UnicodeString,map<UnicodeString,size_t>>>;
-  // WTF is this?
-  // a mutimap of Words to a map of lemmas to a frequency list of POS tags.
-  // this structure is probably overly complex. redesign is needed.
-  // e.g. on output we have te re-sort it to make it usable.
+using mblem_data = lemma_store;
+  // the frequencies of all (Word, lemma, POS tag) triples.
+  // use sorted() to get them ordered on Word, then lemma, then tag.
 
-void fill_lemmas( istream& is,
-		  mblem_data& lems,
-		  const set<UnicodeString>& pos_tags,
-		  const UnicodeString& eos_mark ){
-  size_t line_count = 0;
-  size_t eos_count = 0;
-  int invalid_pos_count = 0;
-  int count_2 = 0;
+struct shard_event {
+  // something the corpus reader would have reported or acted upon.
+  // We only store them while processing a shard, and replay them in
+  // corpus order afterwards, so the diagnostics (and the moment we bail out)
+  // are the same whatever the number of threads
+  enum event_type { TWO_PARTS, UNKNOWN_TAG, WRONG_PARTS };
+  event_type type;
+  size_t line_nr;    // line number, relative to the start of the shard
+  size_t eos_count;  // the number of EOS lines in the shard so far
+  bool lemma_line;   // for UNKNOWN_TAG: was it a 3 part line?
+  UnicodeString tag;
+  UnicodeString line;
+};
+
+struct corpus_shard {
+  string text;     // the raw lines, every line '\n' terminated
+  vector<UnicodeString> decoded; // or the lines, decoded while reading
+  uint64_t bytes = 0; // the size of the input read
+  size_t lines = 0;
+  size_t eos = 0;
+  mblem_data lems;
+  string tag_data; // the (UTF-8) lines for the tagger trainingsfile
+  vector<shard_event> events;
+};
+
+void fill_shard( corpus_shard& shard,
+		 const set<UnicodeString>& pos_tags,
+		 const UnicodeString& eos_mark,
+		 bool do_lemmas,
+		 bool corpus,
+		 bool do_tags ){
+  // decode and split every line of the shard ONCE. Collect the lemma
+  // frequencies and, when 'do_tags', the 2 column trainingsdata for the
+  // tagger. A 'corpus' is checked as such, also when we need no tagger
+  // data from it. Nothing is reported here, all warnings and errors are
+  // stored as events.
+  istringstream is( shard.text );
+  size_t next = 0;
+  auto get_line = [&]( UnicodeString& line ){
+    if ( shard.text.empty() ){
+      if ( next == shard.decoded.size() ){
+	return false;
+      }
+      line = shard.decoded[next++];
+      return true;
+    }
+    return bool( TiCC::getline( is, line, encoding ) );
+  };
+  output_writer tag_os; // in memory
   UnicodeString line;
-  while ( TiCC::getline( is, line, encoding ) ){
-    line_count++;
+  while ( get_line( line ) ){
+    shard.lines++;
     if ( line.isEmpty() ){
+      if ( corpus ){
+	if ( eos_mark == "EL" ){
+	  if ( do_tags ){
+	    tag_os << "\n";
+	  }
+	}
+	else {
+	  shard.events.push_back( { shard_event::WRONG_PARTS,
+				    shard.lines, shard.eos, false, "", line } );
+	  break;
+	}
+      }
       continue;
     }
     if ( line == eos_mark ){
-      eos_count++;
+      shard.eos++;
+      if ( do_tags ){
+	tag_os << line << "\n";
+      }
       continue;
     }
     vector<UnicodeString> parts = TiCC::split_at( line, "\t" );
-    if ( parts.size() == 2 ){
-      // 2 word entry, fine. Count them
-      if ( ++count_2 == 4 ){
-	if (line_count - eos_count == 4 ){
-	  // after the 4 lines with 2 entries have past, we assume it's a 2
-	  // column file, probably a corpus
-	  return;
-	}
-	else {
-	  // so is seems mixes 2 and 3 columns. getting crazy...
-	  cerr << "wrong inputline on line " << line_count << " (confused)" << endl;
-	  exit( EXIT_FAILURE );
-	}
-      }
-      continue; // try some more lines
+    if ( parts.size() != 2 && parts.size() != 3 ){
+      shard.events.push_back( { shard_event::WRONG_PARTS,
+				shard.lines, shard.eos, false, "", line } );
+      // a serial run would have stopped here. So do we.
+      break;
     }
-    else if ( parts.size() != 3 ){
-      cerr << "wrong inputline on line " << line_count << " (should be 3 parts)" << endl;
-      cerr << "'" << line << "'" << endl;
-      exit( EXIT_FAILURE );
+    if ( parts.size() == 2 ){
+      // 2 word entry, fine. The replay will count them
+      shard.events.push_back( { shard_event::TWO_PARTS,
+				shard.lines, shard.eos, false, "", "" } );
     }
-    // we have a 3-parts entry, which can be processed
-    if ( !pos_tags.empty() ){
-      if ( pos_tags.find( parts[2] ) == pos_tags.end() ){
-	cerr << "Warning, unknown POS tag: " << parts[2] << " in line "
-	     << line_count << " '" << line << "'" << endl;
-	if ( ++invalid_pos_count > 10 ){
-	  cerr << "more than 10 invalid POS tags. Please fix your data"
-	       << endl;
-	  exit( EXIT_FAILURE );
-	}
+    const UnicodeString& pos = parts.back();
+    if ( !pos_tags.empty()
+	 && ( corpus || parts.size() == 3 ) ){
+      if ( pos_tags.find( pos ) == pos_tags.end() ){
+	shard.events.push_back( { shard_event::UNKNOWN_TAG,
+				  shard.lines, shard.eos, parts.size() == 3,
+				  pos, line } );
       }
     }
-    UnicodeString uword = TiCC::utrim(parts[0]); // the word
-    UnicodeString ulemma = TiCC::utrim(parts[1]); // the lemma
-    UnicodeString utag = TiCC::utrim(parts[2]); // the POS tag
-    auto it = lems.lower_bound( uword );
-    if ( it == lems.upper_bound( uword ) ){
-      // so a completely new word
-      it = lems.insert( make_pair( uword, map<UnicodeString,map<UnicodeString,size_t>>() ) );
-      ++it->second[ulemma][utag];
+    if ( do_tags ){
+      tag_os << parts[0] << "\t" << pos << "\n";
     }
-    else {
-      // word seen before. But with this lemma?
-      auto it2 = it->second.find( ulemma );
-      if ( it2 == it->second.end() ){
-	// so this lemma not yet done for this word
-	++it->second[ulemma][utag];
-      }
-      else {
-	++it2->second[utag];
-      }
+    if ( parts.size() == 3 && do_lemmas ){
+      // we have a 3-parts entry, which can be processed
+      UnicodeString uword = TiCC::utrim(parts[0]); // the word
+      UnicodeString ulemma = TiCC::utrim(parts[1]); // the lemma
+      UnicodeString utag = TiCC::utrim(parts[2]); // the POS tag
+      shard.lems.add( uword, ulemma, utag );
     }
   }
+  shard.tag_data = tag_os.str();
+  shard.text.clear();
+  shard.text.shrink_to_fit();
+  shard.decoded.clear();
+  shard.decoded.shrink_to_fit();
 }
 
-void write_lemmas( ostream& os,
-		   const mblem_data& lems ){
-  for ( const auto& [word, mmaps] : lems ){
-    for ( const auto& [lemma,posmap] : mmaps ){
-      for( const auto& [dummy,pos] : posmap ){
-	os << word << "\t" << lemma << "\t" << pos << endl;
+string encode( const UnicodeString& us, const string& enc ){
+  // the bytes of 'us' in encoding 'enc'. Empty when that fails
+  int32_t len = us.extract( 0, us.length(), 0, 0, enc.c_str() );
+  string result( len, '\0' );
+  if ( len > 0 ){
+    us.extract( 0, us.length(), &result[0], len, enc.c_str() );
+  }
+  return result;
+}
+
+bool ascii_compatible( const string& enc ){
+  // can the lines of a file in 'enc' be cut from its raw bytes, without
+  // decoding it? True for UTF-8, ISO-8859-x and the like, not for UTF-16
+  const string probe = "<utt>\tEOS_MARK\n";
+  return encode( TiCC::UnicodeFromUTF8( probe ), enc ) == probe;
+}
+
+bool read_shard( istream& is,
+		 corpus_shard& shard,
+		 const UnicodeString& eos_mark,
+		 const string& raw_eos,
+		 bool decode ){
+  // read a chunk of about 'shard_size' bytes, and extend it up to the
+  // next EOS marker.
+  // When 'decode', the lines are decoded here, by the encoding aware reader.
+  // Otherwise they are cut from the raw bytes, and fill_shard() decodes
+  // them later, in parallel. That only works for an ASCII compatible
+  // encoding.
+  const size_t shard_size = 8*1024*1024;
+  if ( decode ){
+    streamoff start = is.rdbuf()->pubseekoff( 0, ios::cur, ios::in );
+    size_t size = 0;
+    UnicodeString line;
+    while ( TiCC::getline( is, line, encoding ) ){
+      size += line.length() + 1;
+      bool eos = ( line == eos_mark
+		   || ( line.isEmpty() && eos_mark == "EL" ) );
+      shard.decoded.push_back( line );
+      if ( size > shard_size
+	   && ( eos || size > 2*shard_size ) ){
+	break;
       }
     }
+    streamoff end = is.rdbuf()->pubseekoff( 0, ios::cur, ios::in );
+    shard.bytes = ( start >= 0 && end >= start ) ? end - start : size;
+    return !shard.decoded.empty();
+  }
+  string line;
+  while ( getline( is, line ) ){
+    shard.text += line;
+    shard.text += '\n';
+    if ( shard.text.size() > shard_size
+	 && ( line == raw_eos
+	      || ( line.empty() && raw_eos == "EL" )
+	      || shard.text.size() > 2*shard_size ) ){
+      // normally we cut at an EOS mark. The hard limit is only for
+      // files without them, which is harmless, as we handle single lines
+      break;
+    }
   }
+  shard.bytes = shard.text.size();
+  return !shard.text.empty();
 }
 
-void create_tagger( const Configuration& config,
-		    const string& base_name,
-		    const string& corpus_name,
+size_t fill_lemmas( istream& is,
+		    mblem_data& lems,
 		    const set<UnicodeString>& pos_tags,
-		    const UnicodeString& eos_mark ){
-  cout << "create a tagger from: " << corpus_name << endl;
-  ifstream corpus( corpus_name );
-  string tag_data_name = temp_dir + base_name + ".data";
-  ofstream os( tag_data_name );
+		    const UnicodeString& eos_mark,
+		    bool corpus = false,
+		    output_writer *tag_os = 0 ){
+  // read a corpus or a lemma list, and add all 3 column entries to 'lems'
+  // returns the number of tokens read.
+  // When 'tag_os' is given, we also write the 2 column trainingsdata for the
+  // tagger of a 'corpus' to it, in the same pass.
+  //
+  // The input is split into shards at EOS boundaries, which are decoded and
+  // counted in parallel when we have more than 1 thread.
+  // The shards are merged in corpus order, so the result is always the same.
+  // With 1 thread, or an encoding that isn't ASCII compatible, the lines
+  // are decoded while reading, as before.
+  bool decode = num_threads == 1 || !ascii_compatible( encoding );
+  string raw_eos = encode( eos_mark, encoding );
   size_t line_count = 0;
-  UnicodeString line;
-  while ( TiCC::getline( corpus, line, encoding ) ){
-    ++line_count;
-    if ( ( line.isEmpty() && eos_mark == "EL" )
-	 || line == eos_mark ){
-      os << line << endl;
+  size_t eos_count = 0;
+  int invalid_pos_count = 0;
+  int count_2 = 0;
+  bool do_lemmas = true;
+  bool more = true;
+  uint64_t bytes = 0;
+  stopwatch parsing;
+  stopwatch aggregation;
+  auto add_timings = [&](){
+    progress.finish( bytes, line_count );
+    timings.add( "parsing", parsing, line_count - eos_count );
+    timings.add( "aggregation", aggregation, line_count - eos_count );
+    timings.count( "lines", line_count );
+    timings.count( "tokens", line_count - eos_count );
+    timings.count( "sentences", eos_count );
+    timings.count( "bytes_read", bytes );
+    return line_count - eos_count;
+  };
+  while ( more ){
+    parsing.start();
+    vector<corpus_shard> shards( num_threads );
+    size_t filled = 0;
+    while ( filled < shards.size()
+	    && read_shard( is, shards[filled], eos_mark, raw_eos, decode ) ){
+      ++filled;
     }
-    else {
-      vector<UnicodeString> parts = TiCC::split_at( line, "\t" );
-      UnicodeString word;
-      UnicodeString pos;
-      if ( parts.size() == 2 ){
-	word = parts[0];
-	pos = parts[1];
+    more = ( filled == shards.size() );
+    shards.resize( filled );
+    for ( const auto& shard : shards ){
+      bytes += shard.bytes;
+    }
+#pragma omp parallel for schedule(dynamic,1)
+    for ( size_t i=0; i < shards.size(); ++i ){
+      fill_shard( shards[i], pos_tags, eos_mark, do_lemmas, corpus,
+		  tag_os != 0 );
+    }
+    parsing.stop();
+    aggregation.start();
+    for ( const auto& shard : shards ){
+      // replay the events, in order
+      for ( const auto& ev : shard.events ){
+	size_t ev_line = line_count + ev.line_nr;
+	size_t ev_eos = eos_count + ev.eos_count;
+	switch ( ev.type ){
+	case shard_event::TWO_PARTS:
+	  if ( do_lemmas && ++count_2 == 4 ){
+	    if ( ev_line - ev_eos == 4 ){
+	      // after the 4 lines with 2 entries have past, we assume it's a 2
+	      // column file, probably a corpus
+	      if ( !corpus ){
+		aggregation.stop();
+		return add_timings();
+	      }
+	      do_lemmas = false;
+	    }
+	    else {
+	      // so is seems mixes 2 and 3 columns. getting crazy...
+	      cerr << "wrong inputline on line " << ev_line << " (confused)" << endl;
+	      exit( EXIT_FAILURE );
+	    }
+	  }
+	  break;
+	case shard_event::WRONG_PARTS:
+	  if ( corpus ){
+	    cerr << "invalid input line (" << ev_line << "): '" << ev.line
+		 << "'" << endl;
+	  }
+	  else {
+	    cerr << "wrong inputline on line " << ev_line << " (should be 3 parts)" << endl;
+	    cerr << "'" << ev.line << "'" << endl;
+	  }
+	  exit( EXIT_FAILURE );
+	  break;
+	case shard_event::UNKNOWN_TAG:
+	  cerr << "Warning, unknown POS tag: " << ev.tag << " in line "
+	       << ev_line << " '" << ev.line << "'" << endl;
+	  if ( do_lemmas
+	       && ev.lemma_line
+	       && ++invalid_pos_count > 10 ){
+	    cerr << "more than 10 invalid POS tags. Please fix your data"
+		 << endl;
+	    exit( EXIT_FAILURE );
+	  }
+	  break;
+	}
       }
-      else if ( parts.size() == 3 ){
-	word = parts[0];
-	pos = parts[2];
+      if ( do_lemmas ){
+	// when we just found out this is a 2 column corpus, the shard
+	// has no lemmas before that point, and we don't want those after.
+	lems.merge( shard.lems );
       }
-      else {
-	cerr << "invalid input line (" << line_count << "): '" << line
-	     << "'" << endl;
-	exit( EXIT_FAILURE );
-      }
-      if ( !pos_tags.empty() ){
-	if ( pos_tags.find( pos ) == pos_tags.end() ){
-	  cerr << "Warning, unknown POS tag: " << pos << " in line " << line_count
-	       << " '" << line << "'" << endl;
-	  //	  exit( EXIT_FAILURE );
-	}
+      if ( tag_os ){
+	*tag_os << shard.tag_data;
       }
-      os << word << "\t" << pos << endl;
+      line_count += shard.lines;
+      eos_count += shard.eos;
     }
+    aggregation.stop();
+    progress.update( bytes, line_count );
+  }
+  return add_timings();
+}
+
+void write_lemmas( output_writer& os,
+		   const mblem_data& lems ){
+  for ( const auto& e : lems.sorted() ){
+    os << lems.str(e.word) << "\t" << lems.str(e.lemma) << "\t"
+       << lems.str(e.tag) << "\n";
   }
-  cout << "created an inputfile for the tagger: " << tag_data_name << endl;
+}
+
+void create_tagger( const Configuration& config,
+		    const string& base_name,
+		    const string& tag_data_name,
+		    ostream& log ){
   string p_pat = config.lookUp( "p", "tagger" );
   string P_pat = config.lookUp( "P", "tagger" );
   string timblopts = config.lookUp( "timblOpts", "tagger" );
@@ -291,11 +508,16 @@ void create_tagger( const Configuration& config,
     + " -n " + n_opt;
   //  taggercommand += " -DLogSilent --tabbed"; // shut up AND tel MBT to only use tabs as separators. Needs recent mbt.
   taggercommand += " -DLogSilent"; // shut up
-  cout << "start tagger: " << taggercommand << endl;
-  cout << "this may take several minutes, depending on the corpus size."
-       << endl;
+  log << "start tagger: " << taggercommand << endl;
+  log << "this may take several minutes, depending on the corpus size."
+      << endl;
+  // the stages may run concurrently, so count the CPU of this thread only
+  stopwatch training( stopwatch::THREAD );
+  training.start();
   MbtAPI::GenerateTagger( taggercommand );
-  cout << "finished creating tagger" << endl;
+  training.stop();
+  timings.add( "training tagger", training, corpus_tokens );
+  log << "finished creating tagger" << endl;
 }
 
 map<UnicodeString,set<UnicodeString>> fill_particles( const string& line ){
@@ -350,219 +572,270 @@ set<UnicodeString> fill_postags( const string& pos_tags_file ){
   return result;
 }
 
-void create_mblem_trainfile( const mblem_data& data,
-			     const map<UnicodeString,set<UnicodeString>>& particles,
-			     const string& _filename ){
-  string filename = temp_dir + _filename;
-  ofstream os( filename );
-  if ( !os ){
-    cerr << "couldn't create mblem datafile: " << filename << endl;
-    exit( EXIT_FAILURE );
-  }
+string mblem_instance( const mblem_data& data,
+		       vector<mblem_data::entry>::const_iterator first,
+		       vector<mblem_data::entry>::const_iterator last,
+		       const particle_matcher& particles,
+		       const vector<vector<uint32_t>>& tag_particles ){
+  // create the trainings instance for one Word. [first,last) are
+  // all the entries for that Word. tag_particles holds the particle
+  // candidates for every tag id.
+  // Only depends on its arguments, so safe to call in parallel
+  UnicodeString wordform = data.str( first->word );
+  vector<int> positions; // where the particles occur in wordform
   UnicodeString outLine;
-  // data is a multimap of Words to a map of lemmas to a frequency list of POS tags.
-  for ( const auto& [wordform,lemma_map] : data ){
-    UnicodeString safeInstance;
-    if ( !outLine.isEmpty() ){
-      string out = UnicodeToUTF8(outLine);
-      out.pop_back(); // remove the final '|'
-      os << out << endl;
-      outLine.remove();
-    }
-    UnicodeString instance;
-    // format instance
-    for ( int i=0; i<HISTORY; i++) {
-      int j= wordform.length()-HISTORY+i;
-      if ( j<0 ) {
-	instance += "= ";
-      }
-      else {
-	instance += wordform[j];
-	instance += " ";
-      }
+  // format instance
+  for ( int i=0; i<HISTORY; i++) {
+    int j= wordform.length()-HISTORY+i;
+    if ( j<0 ) {
+      outLine += "= ";
     }
-    if ( safeInstance.isEmpty() ){
-      // first time around
-      if ( debug ){
-	cerr << "NEW instance " << instance << endl;
-      }
-      safeInstance = instance;
-      outLine = instance;
-    }
-    else if ( instance != safeInstance ){
-      // instance changed. Spit out what we have...
-      if ( debug ){
-	cerr << "instance changed from: " << safeInstance << endl
-	     << "to " << instance << endl;
-      }
-      string out = UnicodeToUTF8(outLine);
-      out.pop_back();
-      os << out << endl;
-      safeInstance = instance;
-      outLine = instance;
-    }
-    multimap<size_t, multimap<UnicodeString,UnicodeString>,std::greater<size_t>> rev_sorted;
-    // rev_sorted is a multimap of counts to a multimap of tag/lemmas names.
-    // highest counts first
-    for ( const auto& [lemma, tag_map] : lemma_map ){
-      for ( const auto& [tag,count] : tag_map ){
-	multimap<UnicodeString,UnicodeString> mm;
-	mm.insert(make_pair(tag,lemma));
-	rev_sorted.insert(make_pair(count,mm));
-      }
+    else {
+      outLine += wordform[j];
+      outLine += " ";
     }
+  }
+  if ( debug ){
+    cerr << "NEW instance " << outLine << endl;
+  }
+  vector<mblem_data::entry> rev_sorted( first, last );
+  // rev_sorted holds the lemma/tag combinations of this Word.
+  // highest counts first. Equal counts stay ordered on lemma and tag
+  stable_sort( rev_sorted.begin(), rev_sorted.end(),
+	       []( const mblem_data::entry& a, const mblem_data::entry& b ){
+		 return a.count > b.count;
+	       } );
+  if ( debug ){
+    cerr << "sorted: " << endl;
+    for ( const auto& e : rev_sorted ){
+      cerr << "<" << data.str(e.tag) << "," << data.str(e.lemma) << "> ("
+	   << e.count << " )" << endl;
+    }
+  }
+  for ( const auto& e : rev_sorted ){
+    UnicodeString lemma = data.str( e.lemma );
+    UnicodeString tag = data.str( e.tag );
     if ( debug ){
-      cerr << "sorted: " << endl;
-      for ( const auto& [count,mmap] : rev_sorted ){
-	cerr << mmap << " (" << count << " )" << endl;
-      }
+      cerr << "LEMMA = " << lemma << endl;
+      cerr << "tag = " << tag << endl;
     }
-    for ( const auto& [dummy,tag_lemma_map] : rev_sorted ){
-      for( const auto& [tag,lemma] : tag_lemma_map ){
+    outLine += tag;
+    UnicodeString prefixed;
+    UnicodeString thisform = wordform;
+    //  find out whether there may be a prefix or infix particle
+    // the candidates are the particles for every partial tag in 'tag'
+    for ( const auto& id : tag_particles[e.tag] ){
+      if ( positions.empty() ){
+	// first time we need them for this Word
+	particles.first_positions( wordform, positions );
+      }
+      int part_pos = positions[id];
+      if ( part_pos != -1 ){
+	const UnicodeString& part = particles.particle( id );
 	if ( debug ){
-	  cerr << "LEMMA = " << lemma << endl;
-	  cerr << "tag = " << tag << endl;
+	  cerr << "alert - " << thisform << " " << lemma << endl;
+	  cerr << "matched " << part << " position: " << part_pos << endl;
 	}
-	outLine += tag;
-	UnicodeString prefixed;
-	UnicodeString thisform = wordform;
-	//  find out whether there may be a prefix or infix particle
-	for( const auto& [seek_tag,parts] : particles ){
-	  if ( !prefixed.isEmpty() ){
-	    break;
+	UnicodeString edit = thisform;
+	//
+	// A bit tricky here
+	// We remove the first particle
+	// the last would be better (e.g 'tegemoetgekomen' )
+	// but then frogs mblem module needs modification too
+	// need more thinking. Are there counterexamples?
+	if ( part_pos < thisform.length()-5 ){
+	  prefixed = part;
+	  edit = edit.remove( part_pos, prefixed.length() );
+	  if ( debug ){
+	    cerr << " simplified from " << thisform
+		 << " to " << edit << " vergelijk: " << lemma << endl;
 	  }
-	  thisform = wordform;
-	  if ( tag.indexOf(seek_tag) >= 0 ){
-	    // the POS tag matches, so potentially yes
-	    for ( const auto& part : parts ){
-	      // loop over potential particles.
-	      int part_pos = thisform.indexOf(part);
-	      if ( part_pos != -1 ){
-		if ( debug ){
-		  cerr << "alert - " << thisform << " " << lemma << endl;
-		  cerr << "matched " << part << " position: " << part_pos << endl;
-		}
-		UnicodeString edit = thisform;
-		//
-		// A bit tricky here
-		// We remove the first particle
-		// the last would be better (e.g 'tegemoetgekomen' )
-		// but then frogs mblem module needs modification too
-		// need more thinking. Are there counterexamples?
-		if ( (size_t)part_pos != string::npos
-		     && part_pos < thisform.length()-5 ){
-		  prefixed = part;
-		  edit = edit.remove( part_pos, prefixed.length() );
-		  if ( debug ){
-		    cerr << " simplified from " << thisform
-			 << " to " << edit << " vergelijk: " << lemma << endl;
-		  }
-		  int ident=0;
-		  while ( ( ident < edit.length() ) &&
-			  ( ident < lemma.length() ) &&
-			  ( edit[ident]==lemma[ident] ) ){
-		    ident++;
-		  }
-		  if ( ident<5 ) {
-		    // so we want at least 5 characters in common between lemma and our
-		    // edit. Otherwise discard.
-		    if ( debug ){
-		      cerr << " must be a fake!" << endl;
-		    }
-		    prefixed = "";
-		  }
-		  else {
-		    thisform = edit;
-		    if ( debug ){
-		      cerr << " edited wordform " << thisform << endl;
-		    }
-		  }
-		}
-	      }
-	      if ( !prefixed.isEmpty() )
-		break;
-	    }
+	  int ident=0;
+	  while ( ( ident < edit.length() ) &&
+		  ( ident < lemma.length() ) &&
+		  ( edit[ident]==lemma[ident] ) ){
+	    ident++;
 	  }
-	}
-
-	UnicodeString deleted;
-	UnicodeString inserted;
-	int ident=0;
-	while ( ident < thisform.length() &&
-		ident < lemma.length() &&
-		thisform[ident]==lemma[ident] ){
-	  ident++;
-	}
-	if ( ident < thisform.length() ) {
-	  for ( int i=ident; i< thisform.length(); i++) {
-	    deleted += thisform[i];
+	  if ( ident<5 ) {
+	    // so we want at least 5 characters in common between lemma and our
+	    // edit. Otherwise discard.
+	    if ( debug ){
+	      cerr << " must be a fake!" << endl;
+	    }
+	    prefixed = "";
 	  }
-	}
-	if ( ident< lemma.length() ) {
-	  for ( int i=ident; i< lemma.length(); i++) {
-	    inserted += lemma[i];
+	  else {
+	    thisform = edit;
+	    if ( debug ){
+	      cerr << " edited wordform " << thisform << endl;
+	    }
+	    break;
 	  }
 	}
-	if ( debug ){
-	  cerr << " word " << thisform << ", lemma " << lemma
-	       << ", prefix " << prefixed
-	       << ", insert " << inserted
-	       << ", delete " << deleted << endl;
-	}
-	if ( !prefixed.isEmpty() ){
-	  outLine += "+P" + prefixed;
-	}
-	if ( !deleted.isEmpty() ){
-	  outLine += "+D" + deleted;
-	}
-	if ( !inserted.isEmpty() ){
-	  outLine += "+I" + inserted;
-	}
-	outLine += "|";
       }
     }
+
+    UnicodeString deleted;
+    UnicodeString inserted;
+    int ident=0;
+    while ( ident < thisform.length() &&
+	    ident < lemma.length() &&
+	    thisform[ident]==lemma[ident] ){
+      ident++;
+    }
+    if ( ident < thisform.length() ) {
+      for ( int i=ident; i< thisform.length(); i++) {
+	deleted += thisform[i];
+      }
+    }
+    if ( ident< lemma.length() ) {
+      for ( int i=ident; i< lemma.length(); i++) {
+	inserted += lemma[i];
+      }
+    }
+    if ( debug ){
+      cerr << " word " << thisform << ", lemma " << lemma
+	   << ", prefix " << prefixed
+	   << ", insert " << inserted
+	   << ", delete " << deleted << endl;
+    }
+    if ( !prefixed.isEmpty() ){
+      outLine += "+P" + prefixed;
+    }
+    if ( !deleted.isEmpty() ){
+      outLine += "+D" + deleted;
+    }
+    if ( !inserted.isEmpty() ){
+      outLine += "+I" + inserted;
+    }
+    outLine += "|";
+  }
+  string out = UnicodeToUTF8(outLine);
+  out.pop_back(); // remove the final '|'
+  return out;
+}
+
+void create_mblem_trainfile( const mblem_data& data,
+			     const map<UnicodeString,set<UnicodeString>>& particles,
+			     const instance_file& file,
+			     ostream& log ){
+  const string& filename = file.name();
+  output_writer os( filename, true );
+  if ( !os ){
+    throw runtime_error( "couldn't create mblem datafile: " + filename );
+  }
+  // the instances are generated by all OpenMP threads, so this counts
+  // the CPU of the whole process. That includes the tagger, when it is
+  // trained at the same time.
+  stopwatch generating;
+  generating.start();
+  vector<mblem_data::entry> entries = data.sorted();
+  // the entries of one Word are consecutive, ordered on lemma and tag.
+  // find where every Word starts.
+  vector<size_t> starts;
+  for ( size_t i=0; i < entries.size(); ++i ){
+    if ( i == 0 || entries[i].word != entries[i-1].word ){
+      starts.push_back( i );
+    }
+  }
+  starts.push_back( entries.size() );
+  size_t words = starts.size() - 1;
+  // compile the particles once, and find the candidates for every tag
+  particle_matcher matcher( particles );
+  vector<vector<uint32_t>> tag_particles( data.strings() );
+  vector<bool> tag_done( data.strings(), false );
+  for ( const auto& e : entries ){
+    if ( !tag_done[e.tag] ){
+      tag_particles[e.tag] = matcher.candidates( data.str( e.tag ) );
+      tag_done[e.tag] = true;
+    }
   }
-  if ( !outLine.isEmpty() ){
-    string out = UnicodeToUTF8(outLine);
-    out.pop_back();
-    os << out << endl;
-    outLine.remove();
+  // the instances are created in blocks of Words, in parallel when we have
+  // more threads. Each block is written in order, so the output is always
+  // the same
+  generating.stop();
+  stopwatch writing( stopwatch::THREAD );
+  const size_t block_size = 10000;
+  vector<string> lines;
+  for ( size_t block=0; block < words; block += block_size ){
+    size_t block_end = min( block + block_size, words );
+    lines.resize( block_end - block );
+    generating.start();
+#pragma omp parallel for schedule(dynamic,64)
+    for ( size_t w=block; w < block_end; ++w ){
+      lines[w-block] = mblem_instance( data,
+				       entries.cbegin() + starts[w],
+				       entries.cbegin() + starts[w+1],
+				       matcher,
+				       tag_particles );
+    }
+    generating.stop();
+    writing.start();
+    for ( const auto& line : lines ){
+      os << line << "\n";
+    }
+    writing.stop();
+  }
+  writing.start();
+  if ( !os.close() ){
+    throw runtime_error( "writing mblem datafile: " + filename + " failed" );
+  }
+  writing.stop();
+  timings.count( "bytes_written", os.bytes_written() );
+  timings.add( "instance generation", generating, words );
+  timings.add( "writing", writing, words );
+  if ( file.in_memory() ){
+    log << "created the mblem trainingsdata in memory" << endl;
+  }
+  else {
+    log << "created a temprorary mblem trainingsfile: " << filename << endl;
   }
-  cout << "created a temprorary mblem trainingsfile: " << filename << endl;
 }
 
 void train_mblem( const Configuration& config,
-		  const string& datafile,
-		  const string& outfile ){
+		  const instance_file& datafile,
+		  const string& outfile,
+		  ostream& log ){
   string timblopts = config.lookUp( "timblOpts", "mblem" );
-  string inputfile = temp_dir + datafile;
-  cout << "Timbl: Start training Lemmas from: " << inputfile
-       << " with Options: '" << timblopts << "'" << endl;
+  log << "Timbl: Start training Lemmas from: "
+      << ( datafile.in_memory() ? "memory" : datafile.name() )
+      << " with Options: '" << timblopts << "'" << endl;
   Timbl::TimblAPI timbl( timblopts );
-  timbl.Learn( inputfile );
+  timbl.Learn( datafile.name() );
   timbl.WriteInstanceBase( outfile );
-  cout << "Timbl: Done, stored Lemma instancebase : " << outfile << endl;
+  log << "Timbl: Done, stored Lemma instancebase : " << outfile << endl;
 }
 
 void create_lemmatizer( const Configuration& config,
 			const mblem_data& data,
 			const map<UnicodeString,set<UnicodeString>>& particles,
-			const string& mblem_tree_file ){
+			const string& mblem_tree_file,
+			ostream& log ){
   if ( data.empty() ){
-    cout << "skip creating a lemmatizer, no lemma data available." << endl;
+    log << "skip creating a lemmatizer, no lemma data available." << endl;
     return;
   }
   string mblem_base = TiCC::basename(mblem_tree_file);
-  string mblem_data_file = mblem_base + ".data";
+  instance_file mblem_data_file( temp_dir + mblem_base + ".data", keep_temp );
   string output_file = output_dir + mblem_base;
-  cout << "create a lemmatizer into: " << output_file << endl;
-  create_mblem_trainfile( data, particles, mblem_data_file );
-  train_mblem( config, mblem_data_file, output_file );
+  log << "create a lemmatizer into: " << output_file << endl;
+  create_mblem_trainfile( data, particles, mblem_data_file, log );
+  stopwatch training( stopwatch::THREAD );
+  training.start();
+  train_mblem( config, mblem_data_file, output_file, log );
+  training.stop();
+  timings.add( "training lemmatizer", training, data.size() );
 }
 
 void check_data( Tokenizer::TokenizerClass *tokenizer,
 		 const mblem_data& data ){
-  for ( const auto& [word,dummy] : data ){
+  uint32_t prev = UINT32_MAX;
+  for ( const auto& e : data.sorted() ){
+    if ( e.word == prev ){
+      continue;
+    }
+    prev = e.word;
+    UnicodeString word = data.str( e.word );
     tokenizer->tokenizeLine( word );
     vector<Tokenizer::Token> v = tokenizer->popSentence();
     if ( v.size() != 1 ){
@@ -581,11 +854,12 @@ void check_data( Tokenizer::TokenizerClass *tokenizer,
 void add_cgn_files( const string& output_dir,
 		    Configuration& config ){
   // copy the cgn files to the output_dir
+  // throws a runtime_error when one of them fails
   string frog_path = string(SYSCONF_PATH) + "/frog/nld/";
   try {
     string infile = frog_path + "cgntags.main";
     if ( !TiCC::isFile( infile ) ){
-      throw( "opening: " + infile + " failed: " );
+      throw runtime_error( "opening: " + infile + " failed" );
     }
     string outfile = output_dir + "cgntags.main";
     ifstream is( infile );
@@ -594,13 +868,12 @@ void add_cgn_files( const string& output_dir,
     config.setatt( "constraints_file", "cgntags.main", "tagger" );
   }
   catch ( const exception& e ){
-    cerr << "adding 'cgntags.main' failed: " << e.what() << endl;
-    exit( EXIT_FAILURE );
+    throw runtime_error( "adding 'cgntags.main' failed: " + string( e.what() ) );
   }
   try {
     string infile = frog_path + "cgntags.sub";
     if ( !TiCC::isFile( infile ) ){
-      throw( "opening: " + infile + " failed: " );
+      throw runtime_error( "opening: " + infile + " failed" );
     }
     string outfile = output_dir + "cgntags.sub";
     ifstream is( infile );
@@ -609,13 +882,12 @@ void add_cgn_files( const string& output_dir,
     config.setatt( "subsets_file", "cgntags.sub", "tagger" );
   }
   catch ( const exception& e ){
-    cerr << "adding 'cgntags.sub' failed: " << e.what() << endl;
-    exit( EXIT_FAILURE );
+    throw runtime_error( "adding 'cgntags.sub' failed: " + string( e.what() ) );
   }
   try {
     string infile = frog_path + "cgn_token.trans";
     if ( !TiCC::isFile( infile ) ){
-      throw( "opening: " + infile + " failed: " );
+      throw runtime_error( "opening: " + infile + " failed" );
     }
 
     string outfile = output_dir + "cgn_token.trans";
@@ -625,27 +897,187 @@ void add_cgn_files( const string& output_dir,
     config.setatt( "token_trans_file", "cgn_token.trans", "tagger" );
   }
   catch ( const exception& e ){
-    cerr << "adding 'cgn_token.trans' failed: " << e.what() << endl;
-    exit( EXIT_FAILURE );
+    throw runtime_error( "adding 'cgn_token.trans' failed: " + string( e.what() ) );
   }
 
 }
 
-void print_data( const mblem_data& data ){
-  for ( const auto& [word,lemma_map] : data ){
-    cerr << word;
-    for( const auto& [lemma,pos_map] : lemma_map ){
-      cerr << "\t" << lemma << endl;
-      for( const auto& [tag,count] : pos_map ){
-	cerr << "\t\t\t" << tag  << " " << count << endl;
+struct stage_inputs {
+  // the hashes of all inputs of a build stage, in a fixed order
+  string stage;
+  vector<pair<string,string>> hashes;
+};
+
+void add_value( stage_inputs& inputs,
+		const string& name,
+		const string& value ){
+  inputs.hashes.push_back( make_pair( name, content_hash().add( value ).hex() ) );
+}
+
+void add_file( stage_inputs& inputs,
+	       const string& name,
+	       const string& filename ){
+  // an unused file is stored as 'none'
+  string hash = "none";
+  if ( !filename.empty() ){
+    content_hash h;
+    if ( !h.add_file( filename ) ){
+      cerr << "unable to read '" << filename << "' for the build cache"
+	   << endl;
+      exit( EXIT_FAILURE );
+    }
+    hash = h.hex();
+  }
+  inputs.hashes.push_back( make_pair( name, hash ) );
+}
+
+vector<string> tagger_outputs( const string& settings_file ){
+  // the files of a tagger: its settings file, and the files mentioned in
+  // there: the lexicons, the list of frequent words and the trees.
+  static const set<string> file_keys = { "l", "L", "r", "k", "u" };
+  vector<string> result = { settings_file };
+  string dir;
+  auto slash = settings_file.rfind( '/' );
+  if ( slash != string::npos ){
+    dir = settings_file.substr( 0, slash+1 );
+  }
+  ifstream is( settings_file );
+  string line;
+  while ( getline( is, line ) ){
+    istringstream ls( line );
+    string key;
+    string value;
+    if ( !( ls >> key >> value )
+	 || file_keys.find( key ) == file_keys.end() ){
+      continue;
+    }
+    if ( value[0] != '/' ){
+      value = dir + value;
+    }
+    result.push_back( value );
+  }
+  return result;
+}
+
+bool up_to_date( const Configuration& cache,
+		 const stage_inputs& inputs,
+		 const vector<string>& outputs ){
+  // a stage may be skipped when all its inputs have the same hash as in
+  // the cache, and all its outputs are still there.
+  for ( const auto& it : inputs.hashes ){
+    string old = cache.getatt( it.first, inputs.stage );
+    if ( old.empty() ){
+      cout << "no previous " << inputs.stage << " build found." << endl;
+      return false;
+    }
+    if ( old != it.second ){
+      cout << "the " << it.first << " of the " << inputs.stage
+	   << " changed." << endl;
+      return false;
+    }
+  }
+  for ( const auto& file : outputs ){
+    if ( !isFile( file ) ){
+      cout << "the " << inputs.stage << " output '" << file << "' is missing."
+	   << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+void store_inputs( Configuration& cache,
+		   const stage_inputs& inputs,
+		   bool valid ){
+  // when not valid, forget about the inputs. So an interrupted build is
+  // never taken for a complete one.
+  for ( const auto& it : inputs.hashes ){
+    if ( valid ){
+      cache.setatt( it.first, it.second, inputs.stage );
+    }
+    else {
+      cache.clearatt( it.first, inputs.stage );
+    }
+  }
+}
+
+struct build_stage {
+  string name;
+  function<void(ostream&)> run;
+};
+
+void run_stages( const vector<build_stage>& stages ){
+  // run the independent build stages, and wait for all of them.
+  // With more than 1 thread, they run concurrently. Each stage then logs to
+  // its own buffer, which is shown as a whole when that stage is done, so
+  // the output doesn't get mixed up.
+  // A stage signals failure by throwing, never by calling exit(), as that
+  // would tear down the process under the feet of the other stages. We
+  // report it and stop, but only after all stages have finished.
+  bool failed = false;
+  if ( num_threads < 2 || stages.size() < 2 ){
+    for ( const auto& stage : stages ){
+      try {
+	stage.run( cout );
+      }
+      catch ( const exception& e ){
+	cerr << "creating the " << stage.name << " failed: " << e.what()
+	     << endl;
+	failed = true;
+	break;
       }
     }
   }
+  else {
+    cout << "start creating the ";
+    for ( size_t i=0; i < stages.size(); ++i ){
+      cout << ( i == 0 ? "" : " and the " ) << stages[i].name;
+    }
+    cout << " concurrently." << endl;
+    vector<ostringstream> logs( stages.size() );
+    vector<future<void>> results;
+    for ( size_t i=0; i < stages.size(); ++i ){
+      results.push_back( async( launch::async, stages[i].run,
+				ref( logs[i] ) ) );
+    }
+    for ( size_t i=0; i < stages.size(); ++i ){
+      try {
+	results[i].get();
+	cout << logs[i].str();
+      }
+      catch ( const exception& e ){
+	cout << logs[i].str();
+	cerr << "creating the " << stages[i].name << " failed: " << e.what()
+	     << endl;
+	failed = true;
+      }
+    }
+  }
+  if ( failed ){
+    exit( EXIT_FAILURE );
+  }
+}
+
+void print_data( const mblem_data& data ){
+  uint32_t prev_word = UINT32_MAX;
+  uint32_t prev_lemma = UINT32_MAX;
+  for ( const auto& e : data.sorted() ){
+    if ( e.word != prev_word ){
+      cerr << data.str(e.word);
+      prev_word = e.word;
+      prev_lemma = UINT32_MAX;
+    }
+    if ( e.lemma != prev_lemma ){
+      cerr << "\t" << data.str(e.lemma) << endl;
+      prev_lemma = e.lemma;
+    }
+    cerr << "\t\t\t" << data.str(e.tag)  << " " << e.count << endl;
+  }
 }
 
 int main( int argc, char * const argv[] ) {
   TiCC::CL_Options opts( "b:t:T:l:e:O:c:hV",
-			 "help,version,postags:,eos:,lemma-out:,temp-dir:,CGN");
+			 "help,version,postags:,eos:,lemma-out:,temp-dir:,CGN,threads:,incremental,keep-temp,timings:,stats");
   try {
     opts.parse_args( argc, argv );
   }
@@ -781,6 +1213,25 @@ int main( int argc, char * const argv[] ) {
     }
   }
   opts.extract( 'e', encoding );
+  if ( opts.extract( "threads", value ) ){
+    if ( !TiCC::stringTo( value, num_threads )
+	 || num_threads < 1 ){
+      cerr << "illegal value for --threads (" << value << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+#ifdef HAVE_OPENMP
+    omp_set_num_threads( num_threads );
+#else
+    if ( num_threads > 1 ){
+      cerr << "No OpenMP support. Ignoring --threads, using 1 thread" << endl;
+      num_threads = 1;
+    }
+#endif
+  }
+  incremental = opts.extract( "incremental" );
+  keep_temp = opts.extract( "keep-temp" );
+  opts.extract( "timings", timings_file );
+  report_progress = opts.extract( "stats" );
   string mblem_particles = use_config.lookUp( "particles", "mblem" );
   map<UnicodeString,set<UnicodeString>> particles;
   if ( !mblem_particles.empty() ){
@@ -791,7 +1242,13 @@ int main( int argc, char * const argv[] ) {
   use_cgn = opts.extract( "CGN" );
   if ( use_cgn ){
     // copy the CGN files to the output_dir and add them to the config
-    add_cgn_files( output_dir, use_config );
+    try {
+      add_cgn_files( output_dir, use_config );
+    }
+    catch ( const exception& e ){
+      cerr << e.what() << endl;
+      exit( EXIT_FAILURE );
+    }
   }
   else {
     // just to be sure.
@@ -804,12 +1261,102 @@ int main( int argc, char * const argv[] ) {
     return EXIT_FAILURE;
   }
   set<UnicodeString> pos_tags = fill_postags( pos_tags_file );
+  string mblem_tree_name = use_config.lookUp( "treeFile", "mblem" );
+  if ( mblem_tree_name.empty() ){
+    if ( lemma_name.empty() ){
+      mblem_tree_name = base_name + ".tree";
+    }
+    else {
+      mblem_tree_name = lemma_name + ".tree";
+    }
+  }
+  string tagger_settings = output_dir + base_name + ".settings";
+  string mblem_tree_file = output_dir + TiCC::basename( mblem_tree_name );
+  bool build_tagger = !lemma_file_only;
+  bool build_lemmatizer = true;
+  Configuration build_cache;
+  string cache_name = output_dir + "froggen.cache";
+  stage_inputs tagger_inputs;
+  stage_inputs lemmatizer_inputs;
+  if ( incremental ){
+    if ( isFile( cache_name )
+	 && !build_cache.fill( cache_name ) ){
+      cerr << "unable to read the build cache: " << cache_name
+	   << " rebuilding everything" << endl;
+      build_cache = Configuration();
+    }
+    cout << "calculating the hashes of all inputs" << endl;
+    tagger_inputs.stage = "tagger";
+    add_file( tagger_inputs, "corpus", corpusname );
+    add_file( tagger_inputs, "postags", pos_tags_file );
+    add_value( tagger_inputs, "eos", TiCC::UnicodeToUTF8( eos_mark ) );
+    add_value( tagger_inputs, "encoding", encoding );
+    for ( const auto& opt : { "p", "P", "timblOpts", "M", "n" } ){
+      add_value( tagger_inputs, opt, use_config.lookUp( opt, "tagger" ) );
+    }
+    add_value( tagger_inputs, "output", tagger_settings );
+    lemmatizer_inputs.stage = "lemmatizer";
+    lemmatizer_inputs.hashes.push_back( tagger_inputs.hashes[0] ); // corpus
+    add_file( lemmatizer_inputs, "lemmas", lemma_name );
+    lemmatizer_inputs.hashes.push_back( tagger_inputs.hashes[1] ); // postags
+    lemmatizer_inputs.hashes.push_back( tagger_inputs.hashes[2] ); // eos
+    lemmatizer_inputs.hashes.push_back( tagger_inputs.hashes[3] ); // encoding
+    add_value( lemmatizer_inputs, "particles", mblem_particles );
+    add_value( lemmatizer_inputs, "timblOpts",
+	       use_config.lookUp( "timblOpts", "mblem" ) );
+    add_value( lemmatizer_inputs, "output", mblem_tree_file );
+    if ( build_tagger
+	 && up_to_date( build_cache, tagger_inputs,
+			tagger_outputs( tagger_settings ) ) ){
+      cout << "the tagger is up to date, reusing: " << tagger_settings << endl;
+      build_tagger = false;
+    }
+    if ( up_to_date( build_cache, lemmatizer_inputs, { mblem_tree_file } ) ){
+      cout << "the lemmatizer is up to date, reusing: " << mblem_tree_file
+	   << endl;
+      build_lemmatizer = false;
+    }
+    // forget the stages we are going to rebuild, until they are done
+    if ( build_tagger ){
+      store_inputs( build_cache, tagger_inputs, false );
+    }
+    if ( build_lemmatizer ){
+      store_inputs( build_cache, lemmatizer_inputs, false );
+    }
+    build_cache.create_configfile( cache_name );
+  }
+  // when nothing is rebuild, we only need the lemmas for --lemma-out or -t
+  bool need_data = build_tagger || build_lemmatizer
+    || !lemma_outname.empty() || tokenizer;
   mblem_data data;
-  if ( !lemma_file_only ){
-    cout << "start reading lemmas from the corpus: " << corpusname << endl;
+  string tag_data_name = temp_dir + base_name + ".data";
+  if ( !lemma_file_only && need_data ){
+    cout << "start reading lemmas and tagger data from the corpus: "
+	 << corpusname << endl;
     cout << "EOS marker = '" << eos_mark << "'" << endl;
     ifstream corpus( corpusname);
-    fill_lemmas( corpus, data, pos_tags, eos_mark );
+    output_writer tag_os;
+    if ( build_tagger ){
+      tag_os.open( tag_data_name, true );
+      if ( !tag_os ){
+	cerr << "couldn't create tagger datafile: " << tag_data_name << endl;
+	exit( EXIT_FAILURE );
+      }
+    }
+    if ( report_progress ){
+      progress.start( "lines", corpusname );
+    }
+    corpus_tokens = fill_lemmas( corpus, data, pos_tags, eos_mark,
+				 true, build_tagger ? &tag_os : 0 );
+    if ( build_tagger ){
+      if ( !tag_os.close() ){
+	cerr << "writing tagger datafile: " << tag_data_name << " failed"
+	     << endl;
+	exit( EXIT_FAILURE );
+      }
+      timings.count( "bytes_written", tag_os.bytes_written() );
+      cout << "created an inputfile for the tagger: " << tag_data_name << endl;
+    }
     if ( debug ){
       cerr << "current data" << endl;
       print_data( data );
@@ -818,36 +1365,39 @@ int main( int argc, char * const argv[] ) {
       cout << "no lemma information found. carry on " << endl;
     }
     else {
-      cout << "done, current size=" << data.size() << endl;
+      cout << "done, current size=" << data.size() << " words, using "
+	   << data.memory_usage() << " bytes" << endl;
     }
   }
-  if ( !lemma_name.empty() ){
+  // the extra lemmas are only needed for the lemmatizer, --lemma-out and -t
+  bool need_lemmas = build_lemmatizer || !lemma_outname.empty() || tokenizer;
+  if ( !lemma_name.empty() && need_lemmas ){
     cout << "start reading extra lemmas from: " << lemma_name << endl;
     ifstream is( lemma_name);
+    if ( report_progress ){
+      progress.start( "lines", lemma_name );
+    }
     fill_lemmas( is, data, pos_tags, eos_mark );
     if ( debug ){
       cerr << "current data" << endl;
       print_data( data );
     }
-    cout << "done, total size=" << data.size() << endl;
+    cout << "done, total size=" << data.size() << " words, using "
+	 << data.memory_usage() << " bytes" << endl;
   }
   if ( debug ){
     cerr << "current data" << endl;
     print_data( data );
   }
   if ( !lemma_outname.empty() ){
-    ofstream os( lemma_outname );
+    output_writer os( lemma_outname );
     write_lemmas( os, data );
-    cout << "created a lemma file: '" << lemma_outname << "'" << endl;
-  }
-  string mblem_tree_name = use_config.lookUp( "treeFile", "mblem" );
-  if ( mblem_tree_name.empty() ){
-    if ( lemma_name.empty() ){
-      mblem_tree_name = base_name + ".tree";
-    }
-    else {
-      mblem_tree_name = lemma_name + ".tree";
+    if ( !os.close() ){
+      cerr << "writing lemma file: " << lemma_outname << " failed" << endl;
+      exit( EXIT_FAILURE );
     }
+    timings.count( "bytes_written", os.bytes_written() );
+    cout << "created a lemma file: '" << lemma_outname << "'" << endl;
   }
   string mblem_set_name = use_config.lookUp( "set", "mblem" );
   if ( mblem_set_name.empty() ){
@@ -861,8 +1411,16 @@ int main( int argc, char * const argv[] ) {
     check_data( tokenizer, data );
   }
   Configuration frog_config = use_config;
+  vector<build_stage> stages;
+  if ( build_tagger ){
+    stages.push_back( { "tagger",
+			[&]( ostream& log ){
+			  log << "create a tagger from: " << corpusname << endl;
+			  create_tagger( use_config, base_name,
+					 tag_data_name, log );
+			} } );
+  }
   if ( !lemma_file_only ){
-    create_tagger( use_config, base_name, corpusname, pos_tags, eos_mark );
     frog_config.setatt( "settings", base_name + ".settings", "tagger" );
     frog_config.clearatt( "p", "tagger" );
     frog_config.clearatt( "P", "tagger" );
@@ -871,10 +1429,27 @@ int main( int argc, char * const argv[] ) {
     frog_config.clearatt( "n", "tagger" );
     frog_config.clearatt( "%", "tagger" );
   }
-  create_lemmatizer( use_config, data, particles, mblem_tree_name );
+  if ( build_lemmatizer ){
+    stages.push_back( { "lemmatizer",
+			[&]( ostream& log ){
+			  create_lemmatizer( use_config, data, particles,
+					     mblem_tree_name, log );
+			} } );
+  }
+  run_stages( stages );
+  if ( incremental ){
+    if ( build_tagger ){
+      store_inputs( build_cache, tagger_inputs, true );
+    }
+    if ( build_lemmatizer ){
+      store_inputs( build_cache, lemmatizer_inputs, true );
+    }
+    build_cache.create_configfile( cache_name );
+    cout << "stored the build cache: " << cache_name << endl;
+  }
   frog_config.clearatt( "baseName", "global" );
   frog_config.clearatt( "particles", "mblem"  );
-  if ( data.empty() ){
+  if ( build_lemmatizer ? data.empty() : !isFile( mblem_tree_file ) ){
     frog_config.clearatt( "treeFile", "mblem" );
     frog_config.clearatt( "set", "mblem" );
     frog_config.clearatt( "timblOpts", "mblem" );
@@ -888,5 +1463,15 @@ int main( int argc, char * const argv[] ) {
   }
   frog_config.create_configfile( frog_cfg );
   cout << "stored a frog configfile template: " << frog_cfg << endl;
+  if ( !timings_file.empty() ){
+    if ( !timings.write_json( timings_file, "froggen" ) ){
+      cerr << "unable to write timings to: " << timings_file << endl;
+      return EXIT_FAILURE;
+    }
+    cout << "stored the timings in: " << timings_file << endl;
+  }
+  else if ( report_progress ){
+    timings.write_json( cout, "froggen" );
+  }
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,540 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include "toad/content_hash.h"
+#include "toad/gazetteer_index.h"
+
+using namespace std;
+using namespace icu;
+
+static const char MAGIC[8] = { 'T', 'O', 'A', 'D', 'G', 'A', 'Z', '1' };
+static const uint32_t ENDIAN_CHECK = 0x01020304;
+
+// the layout of the index file. All sections start at a multiple of 8.
+// A string table is an array of count+1 uint64 offsets, followed by the
+// characters.
+struct gazetteer_index::header {
+  char magic[8];
+  uint32_t byte_order;    // to detect a file from another architecture
+  uint32_t max_ner_size;
+  uint64_t names;
+  uint64_t sources;       // lines 'hash<tab>filename'
+  uint64_t sources_size;
+  uint64_t categories;    // string table, sorted
+  uint64_t category_count;
+  uint64_t tokens;        // string table, sorted
+  uint64_t token_count;
+  uint64_t nodes;         // the trie, node 0 is the root
+  uint64_t node_count;
+  uint64_t sets;          // per set: a uint32 count and the category ids
+  uint64_t sets_size;     // in uint32's
+  uint64_t set_count;
+};
+
+struct gazetteer_index::node {
+  uint32_t token;
+  uint32_t payload;       // 1 + the category set of a name ending here, or 0
+  uint32_t first_child;
+  uint32_t child_count;
+};
+
+gazetteer_index::gazetteer_index():
+  _data( 0 ),
+  _size( 0 ),
+  _header( 0 )
+{
+}
+
+gazetteer_index::~gazetteer_index(){
+  close();
+}
+
+void gazetteer_index::close(){
+  if ( _data ){
+    munmap( const_cast<char*>(_data), _size );
+  }
+  _data = 0;
+  _size = 0;
+  _header = 0;
+  _categories.clear();
+  _sets.clear();
+}
+
+static vector<string> split_ws( const string& line ){
+  vector<string> result;
+  istringstream is( line );
+  string part;
+  while ( is >> part ){
+    result.push_back( part );
+  }
+  return result;
+}
+
+static void pad( ostream& os, uint64_t& pos ){
+  while ( pos % 8 != 0 ){
+    os.put( 0 );
+    ++pos;
+  }
+}
+
+static void write_strings( ostream& os,
+			   uint64_t& pos,
+			   const vector<string>& strings ){
+  uint64_t offset = 0;
+  for ( const auto& s : strings ){
+    os.write( reinterpret_cast<const char*>(&offset), sizeof(offset) );
+    offset += s.size();
+  }
+  os.write( reinterpret_cast<const char*>(&offset), sizeof(offset) );
+  for ( const auto& s : strings ){
+    os.write( s.data(), s.size() );
+  }
+  pos += ( strings.size() + 1 ) * sizeof(uint64_t) + offset;
+  pad( os, pos );
+}
+
+bool gazetteer_index::compile( const string& gazetteer,
+			       const string& index_name,
+			       size_t max_ner_size ){
+  // read the gazetteer and all its lists, and store them as a trie in
+  // 'index_name'.
+  ifstream is( gazetteer );
+  if ( !is ){
+    cerr << "unable to open gazetteer: " << gazetteer << endl;
+    return false;
+  }
+  string dir;
+  auto slash = gazetteer.rfind( '/' );
+  if ( slash != string::npos ){
+    dir = gazetteer.substr( 0, slash+1 );
+  }
+  struct name_entry {
+    vector<uint32_t> tokens;
+    uint32_t category;
+  };
+  vector<name_entry> entries;
+  vector<string> sources( 1, gazetteer );
+  vector<string> categories;
+  map<string,uint32_t> category_ids;
+  vector<string> tokens;
+  unordered_map<string,uint32_t> token_ids;
+  size_t skipped = 0;
+  string line;
+  while ( getline( is, line ) ){
+    vector<string> parts = split_ws( line );
+    if ( parts.empty() || parts[0][0] == '#' ){
+      continue;
+    }
+    if ( parts.size() != 2 ){
+      cerr << "invalid line in gazetteer " << gazetteer << ": '" << line
+	   << "'" << endl;
+      return false;
+    }
+    auto cit = category_ids.find( parts[0] );
+    if ( cit == category_ids.end() ){
+      cit = category_ids.insert( make_pair( parts[0],
+					    categories.size() ) ).first;
+      categories.push_back( parts[0] );
+    }
+    string list_name = parts[1];
+    if ( list_name[0] != '/' ){
+      list_name = dir + list_name;
+    }
+    ifstream ls( list_name );
+    if ( !ls ){
+      cerr << "unable to open gazetteer list: " << list_name << endl;
+      return false;
+    }
+    sources.push_back( list_name );
+    while ( getline( ls, line ) ){
+      vector<string> words = split_ws( line );
+      if ( words.empty() || words[0][0] == '#' ){
+	continue;
+      }
+      if ( words.size() > max_ner_size ){
+	++skipped;
+	continue;
+      }
+      name_entry entry;
+      entry.category = cit->second;
+      for ( const auto& w : words ){
+	auto tit = token_ids.find( w );
+	if ( tit == token_ids.end() ){
+	  tit = token_ids.insert( make_pair( w, tokens.size() ) ).first;
+	  tokens.push_back( w );
+	}
+	entry.tokens.push_back( tit->second );
+      }
+      entries.push_back( std::move(entry) );
+    }
+  }
+  if ( skipped > 0 ){
+    cerr << "skipped " << skipped << " names longer than " << max_ner_size
+	 << " words" << endl;
+  }
+  // renumber the tokens and categories in sorted order
+  auto sorted_ids = []( const vector<string>& strings ){
+    vector<uint32_t> order( strings.size() );
+    for ( size_t i=0; i < order.size(); ++i ){
+      order[i] = i;
+    }
+    sort( order.begin(), order.end(),
+	  [&]( uint32_t a, uint32_t b ){ return strings[a] < strings[b]; } );
+    vector<uint32_t> new_id( strings.size() );
+    for ( size_t i=0; i < order.size(); ++i ){
+      new_id[order[i]] = i;
+    }
+    return new_id;
+  };
+  vector<uint32_t> new_token = sorted_ids( tokens );
+  vector<uint32_t> new_category = sorted_ids( categories );
+  for ( auto& e : entries ){
+    for ( auto& t : e.tokens ){
+      t = new_token[t];
+    }
+    e.category = new_category[e.category];
+  }
+  sort( tokens.begin(), tokens.end() );
+  sort( categories.begin(), categories.end() );
+  sort( entries.begin(), entries.end(),
+	[]( const name_entry& a, const name_entry& b ){
+	  if ( a.tokens != b.tokens ){
+	    return a.tokens < b.tokens;
+	  }
+	  return a.category < b.category;
+	} );
+  // build the trie breadth first, so the children of every node are
+  // consecutive. The names sharing a prefix of 'depth' tokens are in
+  // [lo,hi), the shorter ones first.
+  struct todo_item {
+    uint32_t node;
+    size_t lo;
+    size_t hi;
+    size_t depth;
+  };
+  vector<node> nodes( 1, node{ 0, 0, 0, 0 } );
+  map<vector<uint32_t>,uint32_t> set_ids;
+  vector<uint32_t> sets;
+  deque<todo_item> todo;
+  todo.push_back( { 0, 0, entries.size(), 0 } );
+  while ( !todo.empty() ){
+    todo_item item = todo.front();
+    todo.pop_front();
+    size_t i = item.lo;
+    vector<uint32_t> cats;
+    while ( i < item.hi && entries[i].tokens.size() == item.depth ){
+      if ( cats.empty() || cats.back() != entries[i].category ){
+	cats.push_back( entries[i].category );
+      }
+      ++i;
+    }
+    if ( !cats.empty() ){
+      auto sit = set_ids.find( cats );
+      if ( sit == set_ids.end() ){
+	sit = set_ids.insert( make_pair( cats, set_ids.size() ) ).first;
+	sets.push_back( cats.size() );
+	sets.insert( sets.end(), cats.begin(), cats.end() );
+      }
+      nodes[item.node].payload = sit->second + 1;
+    }
+    nodes[item.node].first_child = nodes.size();
+    uint32_t children = 0;
+    while ( i < item.hi ){
+      uint32_t token = entries[i].tokens[item.depth];
+      size_t j = i;
+      while ( j < item.hi && entries[j].tokens[item.depth] == token ){
+	++j;
+      }
+      nodes.push_back( node{ token, 0, 0, 0 } );
+      todo.push_back( { uint32_t(nodes.size()-1), i, j, item.depth+1 } );
+      ++children;
+      i = j;
+    }
+    nodes[item.node].child_count = children;
+  }
+  string source_block;
+  for ( const auto& src : sources ){
+    content_hash h;
+    if ( !h.add_file( src ) ){
+      cerr << "unable to read: " << src << endl;
+      return false;
+    }
+    source_block += h.hex() + "\t" + src + "\n";
+  }
+  // now write it all, to a temporary file first
+  string temp_name = index_name + ".tmp";
+  ofstream os( temp_name, ios::binary );
+  if ( !os ){
+    cerr << "unable to create: " << temp_name << endl;
+    return false;
+  }
+  header h;
+  memset( &h, 0, sizeof(h) );
+  memcpy( h.magic, MAGIC, sizeof(MAGIC) );
+  h.byte_order = ENDIAN_CHECK;
+  h.max_ner_size = max_ner_size;
+  h.names = entries.size();
+  uint64_t pos = sizeof(header);
+  h.sources = pos;
+  h.sources_size = source_block.size();
+  pos += source_block.size();
+  pos += ( 8 - pos % 8 ) % 8;
+  h.categories = pos;
+  h.category_count = categories.size();
+  for ( const auto& c : categories ){
+    pos += sizeof(uint64_t) + c.size();
+  }
+  pos += sizeof(uint64_t);
+  pos += ( 8 - pos % 8 ) % 8;
+  h.tokens = pos;
+  h.token_count = tokens.size();
+  for ( const auto& t : tokens ){
+    pos += sizeof(uint64_t) + t.size();
+  }
+  pos += sizeof(uint64_t);
+  pos += ( 8 - pos % 8 ) % 8;
+  h.nodes = pos;
+  h.node_count = nodes.size();
+  pos += nodes.size() * sizeof(node);
+  h.sets = pos;
+  h.sets_size = sets.size();
+  h.set_count = set_ids.size();
+  os.write( reinterpret_cast<const char*>(&h), sizeof(h) );
+  uint64_t written = sizeof(header);
+  os.write( source_block.data(), source_block.size() );
+  written += source_block.size();
+  pad( os, written );
+  write_strings( os, written, categories );
+  write_strings( os, written, tokens );
+  os.write( reinterpret_cast<const char*>(nodes.data()),
+	    nodes.size() * sizeof(node) );
+  os.write( reinterpret_cast<const char*>(sets.data()),
+	    sets.size() * sizeof(uint32_t) );
+  os.close();
+  if ( !os ){
+    cerr << "writing " << temp_name << " failed" << endl;
+    return false;
+  }
+  if ( rename( temp_name.c_str(), index_name.c_str() ) != 0 ){
+    cerr << "unable to rename " << temp_name << " to " << index_name << endl;
+    return false;
+  }
+  cout << "compiled " << entries.size() << " names in "
+       << categories.size() << " categories, using " << tokens.size()
+       << " tokens and " << nodes.size() << " trie nodes, into: "
+       << index_name << endl;
+  return true;
+}
+
+bool gazetteer_index::open( const string& index_name ){
+  close();
+  int fd = ::open( index_name.c_str(), O_RDONLY );
+  if ( fd < 0 ){
+    cerr << "unable to open gazetteer index: " << index_name << endl;
+    return false;
+  }
+  struct stat st;
+  if ( fstat( fd, &st ) != 0 || size_t(st.st_size) < sizeof(header) ){
+    ::close( fd );
+    cerr << "invalid gazetteer index: " << index_name << endl;
+    return false;
+  }
+  void *data = mmap( 0, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+  ::close( fd );
+  if ( data == MAP_FAILED ){
+    cerr << "unable to map gazetteer index: " << index_name << endl;
+    return false;
+  }
+  _data = static_cast<const char*>(data);
+  _size = st.st_size;
+  _header = reinterpret_cast<const header*>(_data);
+  const header& h = *_header;
+  if ( memcmp( h.magic, MAGIC, sizeof(MAGIC) ) != 0
+       || h.byte_order != ENDIAN_CHECK
+       || h.sources + h.sources_size > _size
+       || h.categories + (h.category_count+1)*sizeof(uint64_t) > _size
+       || h.tokens + (h.token_count+1)*sizeof(uint64_t) > _size
+       || h.node_count == 0
+       || h.nodes + h.node_count*sizeof(node) > _size
+       || h.sets + h.sets_size*sizeof(uint32_t) > _size ){
+    cerr << "invalid or incompatible gazetteer index: " << index_name << endl;
+    close();
+    return false;
+  }
+  // decode the category names once, and find where every set starts
+  for ( size_t i=0; i < h.category_count; ++i ){
+    _categories.push_back( UnicodeString::fromUTF8( string_at( h.categories,
+							       i ) ) );
+  }
+  const uint32_t *sets = reinterpret_cast<const uint32_t*>(_data + h.sets);
+  size_t pos = 0;
+  for ( size_t i=0; i < h.set_count; ++i ){
+    _sets.push_back( sets + pos );
+    pos += sets[pos] + 1;
+  }
+  return true;
+}
+
+string gazetteer_index::string_at( uint64_t table, uint64_t i ) const {
+  const uint64_t *offsets = reinterpret_cast<const uint64_t*>(_data + table);
+  uint64_t count = ( table == _header->tokens ) ? _header->token_count
+    : _header->category_count;
+  const char *chars = _data + table + ( count + 1 ) * sizeof(uint64_t);
+  return string( chars + offsets[i], offsets[i+1] - offsets[i] );
+}
+
+uint32_t gazetteer_index::find_token( const string& token ) const {
+  // binary search in the sorted token table. returns UINT32_MAX when
+  // not found
+  const uint64_t *offsets =
+    reinterpret_cast<const uint64_t*>(_data + _header->tokens);
+  const char *chars = _data + _header->tokens
+    + ( _header->token_count + 1 ) * sizeof(uint64_t);
+  size_t lo = 0;
+  size_t hi = _header->token_count;
+  while ( lo < hi ){
+    size_t mid = lo + ( hi - lo ) / 2;
+    size_t len = offsets[mid+1] - offsets[mid];
+    int cmp = memcmp( chars + offsets[mid], token.data(),
+		      min( len, token.size() ) );
+    if ( cmp == 0 ){
+      cmp = ( len < token.size() ) ? -1 : ( len > token.size() ? 1 : 0 );
+    }
+    if ( cmp == 0 ){
+      return mid;
+    }
+    if ( cmp < 0 ){
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return UINT32_MAX;
+}
+
+const gazetteer_index::node *gazetteer_index::find_child( const node *parent,
+							  uint32_t token ) const {
+  const node *first = reinterpret_cast<const node*>(_data + _header->nodes)
+    + parent->first_child;
+  const node *last = first + parent->child_count;
+  const node *it = lower_bound( first, last, token,
+				[]( const node& n, uint32_t t ){
+				  return n.token < t; } );
+  if ( it != last && it->token == token ){
+    return it;
+  }
+  return 0;
+}
+
+vector<UnicodeString> gazetteer_index::lookup( const vector<UnicodeString>& words ) const {
+  // every sequence of up to max_ner_size words is looked up, like Frog's
+  // NERTagger::create_ner_list() does. All words of a name get its
+  // categories, in the order they are found: by start position, shorter
+  // names first, and sorted within a name. A category is added only once.
+  vector<uint32_t> ids( words.size() );
+  for ( size_t i=0; i < words.size(); ++i ){
+    string utf8;
+    words[i].toUTF8String( utf8 );
+    ids[i] = find_token( utf8 );
+  }
+  vector<vector<uint32_t>> found( words.size() );
+  const node *root = reinterpret_cast<const node*>(_data + _header->nodes);
+  for ( size_t i=0; i < words.size(); ++i ){
+    const node *current = root;
+    for ( size_t j=i;
+	  j < words.size() && j - i < _header->max_ner_size;
+	  ++j ){
+      if ( ids[j] == UINT32_MAX ){
+	break;
+      }
+      current = find_child( current, ids[j] );
+      if ( !current ){
+	break;
+      }
+      if ( current->payload == 0 ){
+	continue;
+      }
+      const uint32_t *set = _sets[current->payload-1];
+      for ( uint32_t c=1; c <= set[0]; ++c ){
+	for ( size_t k=i; k <= j; ++k ){
+	  if ( find( found[k].begin(), found[k].end(), set[c] )
+	       == found[k].end() ){
+	    found[k].push_back( set[c] );
+	  }
+	}
+      }
+    }
+  }
+  vector<UnicodeString> result( words.size(), "O" );
+  for ( size_t k=0; k < words.size(); ++k ){
+    for ( size_t c=0; c < found[k].size(); ++c ){
+      if ( c == 0 ){
+	result[k] = _categories[found[k][c]];
+      }
+      else {
+	result[k] += "+" + _categories[found[k][c]];
+      }
+    }
+  }
+  return result;
+}
+
+size_t gazetteer_index::names() const {
+  return _header ? _header->names : 0;
+}
+
+bool gazetteer_index::is_stale() const {
+  // compare the hashes of all the source files with the stored ones
+  string block( _data + _header->sources, _header->sources_size );
+  istringstream is( block );
+  string line;
+  while ( getline( is, line ) ){
+    auto tab = line.find( '\t' );
+    if ( tab == string::npos ){
+      return true;
+    }
+    content_hash h;
+    if ( !h.add_file( line.substr( tab+1 ) )
+	 || h.hex() != line.substr( 0, tab ) ){
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,98 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <fstream>
+#include <set>
+#include "toad/output_writer.h"
+#include "toad/instance_aggregator.h"
+
+using namespace std;
+
+static void split_classes( const string& classes, set<string>& result ){
+  size_t start = 0;
+  while ( true ){
+    size_t pos = classes.find( '|', start );
+    result.insert( classes.substr( start, pos - start ) );
+    if ( pos == string::npos ){
+      break;
+    }
+    start = pos + 1;
+  }
+}
+
+void instance_aggregator::add( const string& line ){
+  if ( line.empty() ){
+    return;
+  }
+  ++_instances;
+  size_t pos = line.rfind( _sep );
+  pos = ( pos == string::npos ) ? 0 : pos + 1;
+  // the features keep their last separator
+  auto ins = _aggregates.emplace( line.substr( 0, pos ), aggregate() );
+  aggregate& agg = ins.first->second;
+  ++agg.count;
+  if ( ins.second ){
+    agg.classes = line.substr( pos );
+    _order.push_back( &*ins.first );
+    return;
+  }
+  if ( line.compare( pos, string::npos, agg.classes ) == 0 ){
+    return;
+  }
+  set<string> merged;
+  split_classes( agg.classes, merged );
+  split_classes( line.substr( pos ), merged );
+  agg.classes.clear();
+  for ( const auto& c : merged ){
+    if ( !agg.classes.empty() ){
+      agg.classes += '|';
+    }
+    agg.classes += c;
+  }
+}
+
+bool instance_aggregator::add_file( const string& filename ){
+  // add all instances in the file. returns false when it can't be read.
+  ifstream is( filename );
+  if ( !is ){
+    return false;
+  }
+  string line;
+  while ( getline( is, line ) ){
+    add( line );
+  }
+  return !is.bad();
+}
+
+void instance_aggregator::write( output_writer& os, bool weights ) const {
+  for ( const auto *it : _order ){
+    os << it->first << it->second.classes;
+    if ( weights ){
+      os << _sep << static_cast<size_t>( it->second.count );
+    }
+    os << "\n";
+  }
+}
@@ -0,0 +1,64 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include "config.h"
+#include <unistd.h>
+#ifdef HAVE_MEMFD_CREATE
+#include <sys/mman.h>
+#endif
+#include "toad/instance_file.h"
+
+using namespace std;
+
+instance_file::instance_file( const string& filename, bool keep ):
+  _name( filename ),
+  _fd( -1 )
+{
+#ifdef HAVE_MEMFD_CREATE
+  if ( !keep ){
+    int fd = memfd_create( "toad-instances", MFD_CLOEXEC );
+    if ( fd >= 0 ){
+      string fd_name = "/proc/self/fd/" + to_string( fd );
+      if ( access( fd_name.c_str(), R_OK|W_OK ) == 0 ){
+	_fd = fd;
+	_name = fd_name;
+      }
+      else {
+	// no /proc available.
+	close( fd );
+      }
+    }
+  }
+#else
+  (void)keep;
+#endif
+}
+
+instance_file::~instance_file(){
+  if ( _fd >= 0 ){
+    close( _fd );
+  }
+}
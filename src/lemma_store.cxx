@@ -0,0 +1,214 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <algorithm>
+#include <stdexcept>
+#include "toad/lemma_store.h"
+
+using namespace std;
+using namespace icu;
+
+const uint32_t EMPTY_SLOT = UINT32_MAX;
+
+static inline uint64_t hash_units( const char16_t *s, size_t len ){
+  // FNV-1a over the UTF-16 code units
+  uint64_t h = 14695981039346656037ULL;
+  for ( size_t i=0; i < len; ++i ){
+    h ^= s[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static inline uint64_t hash_triple( uint32_t w, uint32_t l, uint32_t t ){
+  uint64_t h = ( uint64_t(w) << 32 ) ^ ( uint64_t(l) << 16 ) ^ t;
+  h ^= ( uint64_t(l) << 40 );
+  // finalizer from MurmurHash3
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+lemma_store::lemma_store():
+  _offsets( 1, 0 ),
+  _str_table( 1024, EMPTY_SLOT ),
+  _word_count( 0 ),
+  _entry_table( 1024, EMPTY_SLOT )
+{
+}
+
+UnicodeString lemma_store::str( uint32_t id ) const {
+  // return string 'id' as a read-only alias into the arena.
+  // only valid as long as the store isn't modified.
+  return UnicodeString( false,
+			_arena.data() + _offsets[id],
+			_offsets[id+1] - _offsets[id] );
+}
+
+uint64_t lemma_store::str_hash( uint32_t id ) const {
+  return hash_units( _arena.data() + _offsets[id],
+		     _offsets[id+1] - _offsets[id] );
+}
+
+void lemma_store::grow_strings(){
+  vector<uint32_t> table( 2*_str_table.size(), EMPTY_SLOT );
+  size_t mask = table.size() - 1;
+  for ( uint32_t id=0; id < strings(); ++id ){
+    size_t pos = str_hash( id ) & mask;
+    while ( table[pos] != EMPTY_SLOT ){
+      pos = ( pos + 1 ) & mask;
+    }
+    table[pos] = id;
+  }
+  _str_table.swap( table );
+}
+
+uint32_t lemma_store::intern( const UnicodeString& us ){
+  const char16_t *units = us.getBuffer();
+  size_t len = us.length();
+  size_t mask = _str_table.size() - 1;
+  size_t pos = hash_units( units, len ) & mask;
+  while ( _str_table[pos] != EMPTY_SLOT ){
+    uint32_t id = _str_table[pos];
+    if ( _offsets[id+1] - _offsets[id] == len
+	 && equal( units, units + len, _arena.data() + _offsets[id] ) ){
+      return id;
+    }
+    pos = ( pos + 1 ) & mask;
+  }
+  if ( _arena.size() + len >= EMPTY_SLOT ){
+    throw runtime_error( "lemma_store: string arena overflow" );
+  }
+  uint32_t id = strings();
+  _arena.insert( _arena.end(), units, units + len );
+  _offsets.push_back( _arena.size() );
+  _is_word.push_back( false );
+  _str_table[pos] = id;
+  if ( 4 * strings() > 3 * _str_table.size() ){
+    grow_strings();
+  }
+  return id;
+}
+
+void lemma_store::grow_entries(){
+  vector<uint32_t> table( 2*_entry_table.size(), EMPTY_SLOT );
+  size_t mask = table.size() - 1;
+  for ( uint32_t i=0; i < _entries.size(); ++i ){
+    const entry& e = _entries[i];
+    size_t pos = hash_triple( e.word, e.lemma, e.tag ) & mask;
+    while ( table[pos] != EMPTY_SLOT ){
+      pos = ( pos + 1 ) & mask;
+    }
+    table[pos] = i;
+  }
+  _entry_table.swap( table );
+}
+
+void lemma_store::add( const UnicodeString& word,
+		       const UnicodeString& lemma,
+		       const UnicodeString& tag,
+		       size_t count ){
+  uint32_t w = intern( word );
+  uint32_t l = intern( lemma );
+  uint32_t t = intern( tag );
+  size_t mask = _entry_table.size() - 1;
+  size_t pos = hash_triple( w, l, t ) & mask;
+  while ( _entry_table[pos] != EMPTY_SLOT ){
+    entry& e = _entries[_entry_table[pos]];
+    if ( e.word == w && e.lemma == l && e.tag == t ){
+      e.count += count;
+      return;
+    }
+    pos = ( pos + 1 ) & mask;
+  }
+  if ( _entries.size() + 1 >= EMPTY_SLOT ){
+    throw runtime_error( "lemma_store: too many entries" );
+  }
+  _entry_table[pos] = _entries.size();
+  _entries.push_back( { w, l, t, count } );
+  if ( !_is_word[w] ){
+    _is_word[w] = true;
+    ++_word_count;
+  }
+  if ( 4 * _entries.size() > 3 * _entry_table.size() ){
+    grow_entries();
+  }
+}
+
+void lemma_store::merge( const lemma_store& other ){
+  // the ids of other are meaningless here, so add() them by string
+  for ( const auto& e : other._entries ){
+    add( other.str( e.word ), other.str( e.lemma ), other.str( e.tag ),
+	 e.count );
+  }
+}
+
+vector<lemma_store::entry> lemma_store::sorted() const {
+  // return all entries, sorted on word, then lemma, then tag.
+  // this is the same order as iterating a std::map on UnicodeString,
+  // as both compare on UTF-16 code units.
+  vector<uint32_t> ids( strings() );
+  for ( uint32_t id=0; id < ids.size(); ++id ){
+    ids[id] = id;
+  }
+  sort( ids.begin(), ids.end(),
+	[this]( uint32_t a, uint32_t b ){
+	  return lexicographical_compare( _arena.data() + _offsets[a],
+					  _arena.data() + _offsets[a+1],
+					  _arena.data() + _offsets[b],
+					  _arena.data() + _offsets[b+1] );
+	} );
+  vector<uint32_t> rank( ids.size() );
+  for ( uint32_t r=0; r < ids.size(); ++r ){
+    rank[ids[r]] = r;
+  }
+  vector<entry> result = _entries;
+  sort( result.begin(), result.end(),
+	[&rank]( const entry& a, const entry& b ){
+	  if ( a.word != b.word ){
+	    return rank[a.word] < rank[b.word];
+	  }
+	  if ( a.lemma != b.lemma ){
+	    return rank[a.lemma] < rank[b.lemma];
+	  }
+	  return rank[a.tag] < rank[b.tag];
+	} );
+  return result;
+}
+
+size_t lemma_store::memory_usage() const {
+  // an estimate of the number of bytes in use
+  return sizeof(*this)
+    + _arena.capacity() * sizeof(char16_t)
+    + _offsets.capacity() * sizeof(uint32_t)
+    + _str_table.capacity() * sizeof(uint32_t)
+    + _is_word.capacity() / 8
+    + _entries.capacity() * sizeof(entry)
+    + _entry_table.capacity() * sizeof(uint32_t);
+}
@@ -26,11 +26,12 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <iomanip>
 #include <fstream>
 #include <vector>
 #include <map>
-#include <set>
 #include <string>
+#include <sstream>
 #include "ticcutils/StringOps.h"
 #include "ticcutils/CommandLine.h"
 #include "ticcutils/FileUtils.h"
@@ -42,22 +43,30 @@
 #include "unicode/ustream.h"
 #include "unicode/unistr.h"
 #include "frog/mbma_mod.h"
+#include "toad/instance_file.h"
+#include "toad/stage_timer.h"
+#include "toad/output_writer.h"
+#include "toad/feature_window.h"
+#include "toad/ordered_pipeline.h"
+#include "toad/instance_aggregator.h"
 #include "config.h"
 
 using namespace std;
 using namespace	icu;
 
-const int LEFT = 6;
-const int RIGHT = 6;
-
 int debug = 0;
 bool have_config = false;
 string temp_dir = "/tmp/froggen";
 string base_name = "morgen";
 string cgn_dir = string(SYSCONF_PATH) + "/frog/nld/";
 string encoding = "UTF-8";
-
-static Mbma myMbma(new TiCC::LogStream(cerr));
+bool keep_temp = false;
+string timings_file;
+bool report_progress = false;
+int num_threads = 1;
+stage_timer timings;
+progress_meter progress;
+static feature_window window( 6, 6 );
 
 static TiCC::Configuration default_config;
 static TiCC::Configuration use_config;
@@ -70,20 +79,47 @@ void set_default_config(){
   default_config.setatt( "set", "http://ilk.uvt.nl/folia/sets/frog-mbma-nl", "mbma" );
   default_config.setatt( "clex_set", "http://ilk.uvt.nl/folia/sets/frog-mbpos-clex", "mbma" );
   default_config.setatt( "cgnDir", cgn_dir, "mbma" );
+  default_config.setatt( "left_context", "6", "mbma" );
+  default_config.setatt( "right_context", "6", "mbma" );
 }
 
 void usage( const string& name ){
   cerr << name <<" [-c configfile] [-O outputdir] inputfile"
        << endl;
   cerr << "  -c 'config' \t\t an optional configfile. Use only to override the system defaults" << endl;
+  cerr << "\t\t\t Its left_context and right_context keys in [[mbma]] set\n"
+       << "\t\t\t the context window (default 6 and 6). Frog can only use a\n"
+       << "\t\t\t model with other widths when it is configured with the\n"
+       << "\t\t\t same ones." << endl;
   cerr << "  -O 'outputdir' \t Store all files in 'outputdir'"
        << " (Higly recommended)" << endl;
   cerr << "  --temp-dir 'dirname' \t The directory to store teporary files. "
        << "(default: " << temp_dir << " )" << endl;
+  cerr << "  --keep-temp \t\t Keep the Timbl instances in a file in the temp-dir."
+       << endl
+       << "\t\t\t Normally they are kept in memory." << endl;
   cerr << "  --cgn 'cgndir' \t The location of the (required) CGN datafiles."
        << " (default=" << cgn_dir << ")" << endl;
   cerr << "  -b 'basename' \t Set a basename for the outputfiles (default="
        << base_name << ")" << endl;
+  cerr << "  --stats \t\t Report the progress every 10 seconds, and print the"
+       << " JSON\n"
+       << "\t\t\t summary of --timings at the end, when no 'file' is given"
+       << " for it." << endl;
+  cerr << "  --aggregate \t\t Collapse identical instances into one, with the"
+       << " classes\n"
+       << "\t\t\t of all of them, before training Timbl." << endl;
+  cerr << "  --weights \t\t With --aggregate, add the number of collapsed"
+       << " instances\n"
+       << "\t\t\t as exemplar weight, and train with Timbl's -s option."
+       << endl;
+  cerr << "  --threads 'n' \t Check the analyses of the lexicon with 'n' threads,"
+       << " each\n"
+       << "\t\t\t with its own Mbma. The output is the same as with 1 thread."
+       << " (default 1)" << endl;
+  cerr << "  --timings 'file' \t Write the time spent in every stage, the counts,"
+       << " rates\n"
+       << "\t\t\t and memory use to 'file', in JSON." << endl;
   cerr << "  -e 'encoding' \t Normally we handle UTF-8, but other encodings are supported." << endl;
   cerr << "\t\t\t The results will ALWAYS be stored in UTF-8 (NFC normalized)" << endl;
 }
@@ -120,112 +156,371 @@ void copy_cgn_files( const string& output_dir, const string& cgn_path ){
   }
 }
 
-void spitOut( ostream& os, const UnicodeString& word,
-	      vector<set<UnicodeString> >& morphemes ){
-  for ( int i=0; i < word.length(); ++i ){
-    UnicodeString out;
-    // left context
-    for ( int j=0; j<LEFT; j++){
-      if ((i-(LEFT-j))<0)
-	out += "_";
-      else
-	out += word[i-(LEFT-j)];
-      out += ",";
+class class_set {
+  // the morpheme classes seen for one letter of a word, sorted and unique,
+  // like a set<UnicodeString>. There are hardly ever more than a few, so
+  // the first ones are stored inline. clear() keeps the strings, so
+  // their memory is reused for the next word
+ public:
+  void clear(){ _size = 0; };
+  size_t size() const { return _size; };
+  const UnicodeString& operator[]( size_t i ) const {
+    return i < INLINE ? _inline[i] : _more[i-INLINE];
+  };
+  void insert( const UnicodeString& c ){
+    size_t pos = 0;
+    while ( pos < _size && at(pos) < c ){
+      ++pos;
+    }
+    if ( pos < _size && at(pos) == c ){
+      return;
+    }
+    if ( _size >= INLINE && _size - INLINE >= _more.size() ){
+      _more.emplace_back();
+    }
+    // move the unused string at the end to 'pos'
+    for ( size_t k=_size; k > pos; --k ){
+      at(k).swap( at(k-1) );
+    }
+    at(pos) = c;
+    ++_size;
+  };
+ private:
+  UnicodeString& at( size_t i ){
+    return i < INLINE ? _inline[i] : _more[i-INLINE];
+  };
+  static const size_t INLINE = 3;
+  UnicodeString _inline[INLINE];
+  vector<UnicodeString> _more;
+  size_t _size = 0;
+};
+
+class word_classes {
+  // the classes of every letter of the current word. It grows to the
+  // longest word seen, and is reused for every next word
+ public:
+  void reset( size_t len ){
+    if ( _sets.size() < len ){
+      _sets.resize( len );
     }
-    // focus
-    out += word[i];
-    out += ",";
-    // right context
-    for ( int j=0; j<RIGHT; j++) {
-      if ( (i+j+1) >= word.length() )
-	out += "_";
-      else
-	out += word[i+j+1];
-      out += ",";
+    for ( size_t i=0; i < len; ++i ){
+      _sets[i].clear();
     }
+    _len = len;
+  };
+  size_t size() const { return _len; };
+  class_set& operator[]( size_t i ){ return _sets[i]; };
+  const class_set& operator[]( size_t i ) const { return _sets[i]; };
+ private:
+  vector<class_set> _sets;
+  size_t _len = 0;
+};
+
+struct instance_buffer {
+  // the buffers to build the instances of a word. They are reused for
+  // every word, so they hardly ever allocate
+  string padded;          // the padded word, every position followed by ','
+  vector<size_t> offsets; // where every position starts in 'padded'
+  string out;             // the instances, UTF-8 encoded
+};
+
+void spitOut( instance_buffer& buf, const UnicodeString& word,
+	      const word_classes& morphemes ){
+  // the word is encoded once, padded with "_" on both sides. The window of
+  // position 'i' is then one slice of it, so it moves along the word
+  // without building anything.
+  // The positions are UTF-16 units, just as the morphemes are
+  const size_t len = word.length();
+  string& padded = buf.padded;
+  vector<size_t>& offsets = buf.offsets;
+  padded.clear();
+  offsets.clear();
+  for ( size_t k=0; k < window.left(); ++k ){
+    offsets.push_back( padded.size() );
+    padded += "_,";
+  }
+  char enc[3];
+  for ( size_t k=0; k < len; ++k ){
+    offsets.push_back( padded.size() );
+    padded.append( enc, utf8_unit( word[k], enc ) );
+    padded += ',';
+  }
+  for ( size_t k=0; k < window.right(); ++k ){
+    offsets.push_back( padded.size() );
+    padded += "_,";
+  }
+  offsets.push_back( padded.size() );
+  const size_t width = window.width();
+  string& out = buf.out;
+  for ( size_t i=0; i < len; ++i ){
+    out.append( padded, offsets[i], offsets[i+width] - offsets[i] );
     // class
-    auto it = morphemes[i].begin();
-    while ( it != morphemes[i].end() ){
-      out += *it;
-      ++it;
-      if ( it != morphemes[i].end() )
-	out += "|";
+    const class_set& classes = morphemes[i];
+    for ( size_t k=0; k < classes.size(); ++k ){
+      if ( k > 0 ){
+	out += '|';
+      }
+      classes[k].toUTF8String( out );
     }
-    os << out << endl;
+    out += '\n';
   }
 }
 
-void create_instance_file( const string& inpname, const string& outname ){
+struct morph_entry {
+  // one line of the lexicon: a word and its morphemes, one per letter
+  UnicodeString line;
+  UnicodeString word;
+  vector<UnicodeString> parts;
+  bool valid = false;
+};
+
+struct morph_batch {
+  vector<morph_entry> entries;
+  size_t lines = 0;   // the lines read, empty ones included
+  uint64_t bytes = 0; // the position in the input after the batch, or 0
+};
+
+size_t create_instance_file( const vector<Mbma*>& analysers,
+			     const string& inpname,
+			     const instance_file& outfile ){
+  // returns the number of words handled
+  //
+  // Checking the analyses with Mbma is done by a worker per analyser.
+  // Batches of lines are only cut where the word changes, and the results
+  // are handled in the original order, so the words are grouped just like
+  // when done one by one.
+  const string& outname = outfile.name();
   ifstream bron( inpname );
   if ( !bron ){
     cerr << "could not open input file '" << inpname << "'" << endl;
     exit(EXIT_FAILURE);
   }
 
-  ofstream os( outname );
+  output_writer os( outname, true );
   if ( !os ){
     cerr << "could not open output file '" << outname << "'" << endl;
     exit(EXIT_FAILURE);
   }
   cerr << "start converting inputfile: " << inpname << endl;
-  vector<set<UnicodeString> > morphemes;
-  morphemes.resize(250);
+  word_classes morphemes;
   UnicodeString prevword;
-  UnicodeString line;
-  while ( TiCC::getline( bron, line, encoding ) ){
-    if ( line.isEmpty() ){
-	continue;
+  stopwatch total;
+  // these run in the reader, the workers and the writer of the pipeline,
+  // next to each other
+  stopwatch parsing( stopwatch::THREAD );
+  vector<stopwatch> validating( analysers.size(),
+				stopwatch( stopwatch::THREAD ) );
+  stopwatch generating( stopwatch::THREAD );
+  stopwatch writing( stopwatch::THREAD );
+  size_t words = 0;
+  size_t lines = 0;
+  uint64_t bytes_read = 0;
+  instance_buffer buf;
+  auto timed_spitOut = [&]( const UnicodeString& word ){
+    generating.start();
+    buf.out.clear();
+    spitOut( buf, word, morphemes );
+    generating.stop();
+    writing.start();
+    os << buf.out;
+    writing.stop();
+    ++words;
+  };
+  total.start();
+  if ( report_progress ){
+    progress.start( "words", inpname );
+  }
+  const size_t batch_size = 1000;
+  morph_entry pending; // the first line of the next batch
+  bool have_pending = false;
+  string problem;
+  auto read_batch = [&]( morph_batch& batch ){
+    if ( !problem.empty() ){
+      return false;
     }
-    vector<UnicodeString> parts = TiCC::split( line );
-    int num = parts.size();
-    if ( num < 2 ){
-      cerr << "Problem in line '" << line << "' (to short?)" << endl;
-      exit(1);
+    parsing.start();
+    if ( have_pending ){
+      batch.entries.push_back( std::move(pending) );
+      have_pending = false;
     }
-    UnicodeString word = parts[0];
-    if ( word.length() != num-1 ){
-      cerr << "Problem in line '" << line << "' (" << word.length()
-	   << " letters, but got " << num-1 << " morphemes)" << endl;
-      exit(1);
+    morph_entry entry;
+    while ( TiCC::getline( bron, entry.line, encoding ) ){
+      ++batch.lines;
+      if ( entry.line.isEmpty() ){
+	continue;
+      }
+      entry.parts = TiCC::split( entry.line );
+      int num = entry.parts.size();
+      if ( num < 2 ){
+	// stop reading. we bail out after all previous lines are done
+	ostringstream msg;
+	msg << "Problem in line '" << entry.line << "' (to short?)";
+	problem = msg.str();
+	break;
+      }
+      entry.word = entry.parts[0];
+      if ( entry.word.length() != num-1 ){
+	ostringstream msg;
+	msg << "Problem in line '" << entry.line << "' ("
+	    << entry.word.length() << " letters, but got " << num-1
+	    << " morphemes)";
+	problem = msg.str();
+	break;
+      }
+      entry.parts.erase(entry.parts.begin());
+      if ( batch.entries.size() >= batch_size
+	   && entry.word != batch.entries.back().word ){
+	pending = std::move(entry);
+	have_pending = true;
+	break;
+      }
+      batch.entries.push_back( std::move(entry) );
+      entry = morph_entry();
+    }
+    if ( progress.active() && bron ){
+      // at EOF, tellg() fails
+      batch.bytes = bron.tellg();
     }
-    parts.erase(parts.begin());
-    vector<Rule *> r = myMbma.execute( word, "", parts );
-    if ( r.empty() ){
-      cerr << "problems with entry: '" << line << "'" << endl;
-      continue;
+    parsing.stop();
+    return !batch.entries.empty();
+  };
+  auto validate_batch = [&]( size_t id, morph_batch& batch ){
+    validating[id].start();
+    for ( auto& entry : batch.entries ){
+      vector<Rule *> r = analysers[id]->execute( entry.word, "",
+						 entry.parts );
+      entry.valid = !r.empty();
     }
-    if ( word != prevword ){
-      if ( !prevword.isEmpty() ){
-	spitOut( os, prevword, morphemes );
+    validating[id].stop();
+    return std::move(batch);
+  };
+  auto handle_batch = [&]( morph_batch& batch ){
+    for ( const auto& entry : batch.entries ){
+      if ( !entry.valid ){
+	cerr << "problems with entry: '" << entry.line << "'" << endl;
+	continue;
+      }
+      if ( entry.word != prevword ){
+	if ( !prevword.isEmpty() ){
+	  timed_spitOut( prevword );
+	}
+	prevword = entry.word;
+	morphemes.reset( entry.word.length() );
       }
-      prevword = word;
-      for ( size_t i=0; i < morphemes.size(); ++i ){
-	morphemes[i].clear();
+      for ( size_t i=0; i < entry.parts.size(); ++i ){
+	morphemes[i].insert(entry.parts[i]);
       }
     }
-    for ( size_t i=0; i < parts.size(); ++i ){
-      morphemes[i].insert(parts[i]);
+    lines += batch.lines;
+    if ( batch.bytes > 0 ){
+      progress.update( batch.bytes, words );
     }
+  };
+  ordered_pipeline<morph_batch,morph_batch> pipeline( analysers.size(),
+						      4*analysers.size() );
+  pipeline.run( read_batch, validate_batch, handle_batch );
+  if ( !problem.empty() ){
+    cerr << problem << endl;
+    exit(1);
   }
   if ( !prevword.isEmpty() ){
-    spitOut( os, prevword, morphemes );
+    timed_spitOut( prevword );
+  }
+  writing.start();
+  if ( !os.close() ){
+    cerr << "writing to '" << outname << "' failed" << endl;
+    exit(EXIT_FAILURE);
+  }
+  writing.stop();
+  total.stop();
+  bron.clear(); // at EOF, tellg() fails
+  bytes_read = bron.tellg();
+  progress.finish( bytes_read, words );
+  // with more workers, this is the time summed over all workers
+  stopwatch validate_time;
+  for ( const auto& sw : validating ){
+    validate_time += sw;
   }
-  cerr << "created morphological datafile: " << outname << endl;
+  timings.add( "parsing", parsing, words );
+  timings.add( "validation", validate_time, words );
+  timings.add( "instance generation", generating, words );
+  timings.add( "writing", writing, words );
+  timings.count( "lines", lines );
+  timings.count( "words", words );
+  timings.count( "bytes_read", bytes_read );
+  timings.count( "bytes_written", os.bytes_written() );
+  if ( outfile.in_memory() ){
+    cerr << "created morphological data in memory" << endl;
+  }
+  else {
+    cerr << "created morphological datafile: " << outname << endl;
+  }
+  return words;
 }
 
-void create_instance_base( const string& dataname, const string& treename ){
+void aggregate_instances( const instance_file& datafile,
+			  const instance_file& outfile,
+			  bool weights ){
+  // collapse the identical instances, so Timbl learns from less
+  stopwatch aggregating;
+  aggregating.start();
+  instance_aggregator aggregator( ',' );
+  if ( !aggregator.add_file( datafile.name() ) ){
+    cerr << "unable to read the instances from: " << datafile.name() << endl;
+    exit(EXIT_FAILURE);
+  }
+  output_writer os( outfile.name() );
+  if ( !os ){
+    cerr << "could not open output file '" << outfile.name() << "'" << endl;
+    exit(EXIT_FAILURE);
+  }
+  aggregator.write( os, weights );
+  if ( !os.close() ){
+    cerr << "writing to '" << outfile.name() << "' failed" << endl;
+    exit(EXIT_FAILURE);
+  }
+  aggregating.stop();
+  size_t before = aggregator.instances();
+  size_t after = aggregator.size();
+  timings.add( "aggregation", aggregating, before );
+  timings.count( "instances", before );
+  timings.count( "aggregated_instances", after );
+  cout << "aggregated " << before << " instances into " << after;
+  if ( before > 0 ){
+    ostringstream percent; // keep the format flags of cout as they are
+    percent << fixed << setprecision(1)
+	    << 100.0 * ( before - after ) / before;
+    cout << " (" << percent.str() << "% less)";
+  }
+  cout << " in " << aggregating.seconds() << " seconds" << endl;
+}
+
+void create_instance_base( const instance_file& datafile,
+			   const string& treename,
+			   size_t words,
+			   bool weights ){
   string timblopts = use_config.lookUp( "timblOpts", "mbma" );
-  cout << "Timbl: Start training " << dataname << " with Options: "
-       << timblopts << endl;
+  if ( weights ){
+    // the last column of every instance is its exemplar weight
+    timblopts += " -s";
+  }
+  cout << "Timbl: Start training "
+       << ( datafile.in_memory() ? "from memory" : datafile.name() )
+       << " with Options: " << timblopts << endl;
 
+  stopwatch training;
+  training.start();
   Timbl::TimblAPI timbl( timblopts );
-  timbl.Learn( dataname );
+  timbl.Learn( datafile.name() );
   timbl.WriteInstanceBase( treename );
-  cout << "Timbl: Done, stored instancebase : " << treename << endl;
+  training.stop();
+  timings.add( "training", training, words );
+  cout << "Timbl: Done, stored instancebase : " << treename
+       << " (training took " << training.seconds() << " seconds)" << endl;
 }
 
 int main(int argc, char * const argv[] ) {
-  TiCC::CL_Options opts("b:O:c:hV","version,help,cgn:,temp-dir,encoding:");
+  TiCC::CL_Options opts("b:O:c:hV","version,help,cgn:,temp-dir:,encoding:,keep-temp,timings:,stats,threads:,aggregate,weights");
   try {
     opts.parse_args( argc, argv );
   }
@@ -266,6 +561,9 @@ int main(int argc, char * const argv[] ) {
     use_config.setatt( "baseName", base_name, "mbma" );
   }
   use_config.merge( default_config ); // to be sure to have all we need
+  if ( !context_window( use_config, "mbma", window ) ){
+    exit( EXIT_FAILURE );
+  }
   opts.extract( "temp-dir", temp_dir );
   cerr << "TEMP_DIR =" << temp_dir << endl;
   if ( !temp_dir.empty() ){
@@ -279,6 +577,23 @@ int main(int argc, char * const argv[] ) {
     }
   }
   opts.extract( 'e', encoding );
+  keep_temp = opts.extract( "keep-temp" );
+  bool aggregate = opts.extract( "aggregate" );
+  bool weights = opts.extract( "weights" );
+  if ( weights && !aggregate ){
+    cerr << "--weights is only possible with --aggregate" << endl;
+    exit(EXIT_FAILURE);
+  }
+  opts.extract( "timings", timings_file );
+  report_progress = opts.extract( "stats" );
+  string value;
+  if ( opts.extract( "threads", value ) ){
+    if ( !TiCC::stringTo( value, num_threads )
+	 || num_threads < 1 ){
+      cerr << "illegal value for --threads (" << value << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+  }
   vector<string> names = opts.getMassOpts();
   if ( names.size() == 0 ){
     cerr << "missing inputfile" << endl;
@@ -296,7 +611,6 @@ int main(int argc, char * const argv[] ) {
   TiCC::Configuration frog_config = use_config;
   //  frog_config.clearatt( "configDir", "global" );
   string inpname = names[0];
-  string data_out_name = temp_dir + base_name + ".data";
   string treename = use_config.lookUp( "treeFile", "mbma" );
   if ( treename.empty() ){
     treename = base_name + ".tree";
@@ -319,8 +633,25 @@ int main(int argc, char * const argv[] ) {
   copy_cgn_files( outputdir, cgn_dir );
   frog_config.setatt( "treeFile", treename, "mbma" );
   string full_treename = outputdir + treename;
-  create_instance_file( inpname, data_out_name );
-  create_instance_base( data_out_name, full_treename );
+  instance_file data_out( temp_dir + base_name + ".data", keep_temp );
+  vector<Mbma*> analysers;
+  for ( int i=0; i < num_threads; ++i ){
+    // every thread needs an analyser of its own
+    analysers.push_back( new Mbma( new TiCC::LogStream(cerr) ) );
+  }
+  size_t words = create_instance_file( analysers, inpname, data_out );
+  for ( const auto& analyser : analysers ){
+    delete analyser;
+  }
+  if ( aggregate ){
+    instance_file aggregated( temp_dir + base_name + ".aggregated.data",
+			      keep_temp );
+    aggregate_instances( data_out, aggregated, weights );
+    create_instance_base( aggregated, full_treename, words, weights );
+  }
+  else {
+    create_instance_base( data_out, full_treename, words, false );
+  }
 
   frog_config.clearatt( "baseName", "mbma" );
 
@@ -341,5 +672,15 @@ int main(int argc, char * const argv[] ) {
   }
   frog_config.create_configfile( cfg_out );
   cout << "stored a frog configfile template: " << cfg_out << endl;
+  if ( !timings_file.empty() ){
+    if ( !timings.write_json( timings_file, "morgen" ) ){
+      cerr << "unable to write timings to: " << timings_file << endl;
+      return EXIT_FAILURE;
+    }
+    cout << "stored the timings in: " << timings_file << endl;
+  }
+  else if ( report_progress ){
+    timings.write_json( cout, "morgen" );
+  }
   return EXIT_SUCCESS;
 }
@@ -29,7 +29,9 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <sstream>
 #include <exception>
+#include <mutex>
 #include "ticcutils/StringOps.h"
 #include "ticcutils/CommandLine.h"
 #include "ticcutils/FileUtils.h"
@@ -41,6 +43,12 @@
 #include "unicode/ustream.h"
 #include "unicode/unistr.h"
 #include "frog/ner_tagger_mod.h"
+#include "toad/stage_timer.h"
+#include "toad/ordered_pipeline.h"
+#include "toad/gazetteer_index.h"
+#include "toad/output_writer.h"
+#include "toad/tag_cache.h"
+#include "toad/feature_window.h"
 #include "config.h"
 
 using namespace std;
@@ -48,9 +56,19 @@ using namespace std;
 TiCC::LogStream mylog(cerr);
 
 static NERTagger myNer(&mylog);
+static gazetteer_index gazetteer; // used instead of myNer's gazetteer when open
+static mutex ner_lock; // myNer is shared by all workers, and not thread safe
 
 string EOS_MARK = "\n";
 
+string timings_file;
+bool report_progress = false;
+progress_meter progress;
+int num_threads = 1;
+stage_timer timings;
+static tag_cache tagging_cache;
+static feature_window window( 1, 1 );
+
 static TiCC::Configuration default_config; // sane defaults
 static TiCC::Configuration use_config;     // the config we gonna use
 
@@ -67,7 +85,8 @@ void set_default_config(){
 		    "NER" );
   default_config.setatt( "set", "http://ilk.uvt.nl/folia/sets/frog-ner-nl", "NER" );
   default_config.setatt( "max_ner_size", "15", "NER" );
-
+  default_config.setatt( "left_context", "1", "NER" );
+  default_config.setatt( "right_context", "1", "NER" );
 }
 
 class setting_error: public std::runtime_error {
@@ -86,6 +105,10 @@ void usage( const string& name ){
        << endl;
   cerr << "-c 'configfile'\t An existing configfile that will be enriched\n"
        << "\t\t with additional NER specific information." << endl;
+  cerr << "\t\t Its left_context and right_context keys in [[NER]] set the\n"
+       << "\t\t context window (default 1 and 1). Frog can only use a model\n"
+       << "\t\t with other widths when it is configured with the same ones."
+       << endl;
   cerr << "-O 'outputdir'\t The directoy where all the outputfiles are stored\n"
        << "\t\t highly recommended to use, because a lot of files are created\n"
        << "\t\t and your working directory will get cluttered." << endl;
@@ -95,8 +118,29 @@ void usage( const string& name ){
        << "\t\t        'ner-catn<tab> filen'" << endl
        << "\t\t were every file-1 .. file-N is a list of space separated names"
        << endl;
+  cerr << "--compile-gazetteer compile the gazetteer into 'gazetteer'.idx and stop.\n"
+       << "\t\t When that index exists and is up to date, it is used instead of\n"
+       << "\t\t the gazetteer lists, which is much faster to start." << endl;
   cerr << "--override\t override O NER tags with those derived from the gazeteers," << endl
        << "\t\t so ONLY when there is NO CONFLICT" << endl;
+  cerr << "--threads 'n' use 'n' threads, each with its own POS tagger, to"
+       << " enrich the\n"
+       << "\t\t corpus. With --bootstrap, 'n' threads do the gazetteer lookups,\n"
+       << "\t\t but only with the index of --compile-gazetteer. Without it,\n"
+       << "\t\t --threads is ignored for --bootstrap. The index gives the same\n"
+       << "\t\t results as the lists, so it is recommended.\n"
+       << "\t\t The output is the same as with 1 thread. (default 1)"
+       << endl;
+  cerr << "--tag-cache 'file' keep the POS tags of all sentences in 'file',\n"
+       << "\t\t and only tag sentences that are not in there yet. The cache\n"
+       << "\t\t can be shared with chunkgen." << endl;
+  cerr << "--stats report the progress every 10 seconds, instead of dots,"
+       << " and print\n"
+       << "\t\t the JSON summary of --timings at the end, when no 'file' is\n"
+       << "\t\t given for it." << endl;
+  cerr << "--timings 'file' write the time spent in every stage, the counts,"
+       << " rates and\n"
+       << "\t\t memory use to 'file', in JSON." << endl;
   cerr << "--bootstrap\t override ALL NER tags with those derived from the gazeteers." << endl
        << "\t\t UNCONDITIONALLY. Creates a new trainfile for nergen, and stops then. " << endl;
   cerr << "--running When using --bootstrap, you can specify this, to signal an input file" << endl
@@ -111,19 +155,64 @@ bool fill_gazet( const string& name ){
   return myNer.read_gazets( file, dir );
 }
 
-void spit_out( ostream& os,
-	       const vector<Tagger::TagResult>& tagv,
-	       const vector<UnicodeString>& orig_ner_file_tags,
-	       bool override,
-	       bool bootstrap ){
-  vector<UnicodeString> words;
-  vector<UnicodeString> tags;
+bool open_gazet_index( const string& name ){
+  // use the compiled index of gazetteer 'name', when it is there and
+  // up to date
+  string index_name = name + ".idx";
+  if ( !TiCC::isFile( index_name ) ){
+    return false;
+  }
+  if ( !gazetteer.open( index_name ) ){
+    cerr << "WARNING: falling back to the gazetteer lists" << endl;
+    return false;
+  }
+  if ( gazetteer.is_stale() ){
+    cerr << "WARNING: the gazetteer index " << index_name
+	 << " is out of date, falling back to the gazetteer lists.\n"
+	 << "\t use --compile-gazetteer to rebuild it." << endl;
+    gazetteer.close();
+    return false;
+  }
+  cout << "using gazetteer index: " << index_name << " ("
+       << gazetteer.names() << " names)" << endl;
+  return true;
+}
+
+vector<UnicodeString> ner_list( const vector<UnicodeString>& words ){
+  // the compiled index may be searched concurrently, the gazetteer lists
+  // of myNer only one worker at a time
+  if ( gazetteer.is_open() ){
+    return gazetteer.lookup( words );
+  }
+  lock_guard<mutex> guard( ner_lock );
+  return myNer.create_ner_list( words );
+}
+
+void tag_sentence( MbtAPI *tagger,
+		   const UnicodeString& blob,
+		   vector<UnicodeString>& words,
+		   vector<UnicodeString>& tags ){
+  // POS tag the sentence, unless the result is in the cache
+  if ( tagging_cache.lookup( blob, words, tags ) ){
+    return;
+  }
+  vector<Tagger::TagResult> tagv = tagger->TagLine( blob );
   for( const auto& tr : tagv ){
     words.push_back( tr.word() );
     tags.push_back( tr.assigned_tag() );
   }
+  tagging_cache.store( blob, words, tags );
+}
 
-  vector<UnicodeString> gazet_tags = myNer.create_ner_list( words );
+void spit_out( output_writer& os,
+	       const vector<UnicodeString>& words,
+	       const vector<UnicodeString>& tags,
+	       const vector<UnicodeString>& orig_ner_file_tags,
+	       bool override,
+	       bool bootstrap,
+	       const string& eos_mark ){
+
+  vector<UnicodeString> gazet_tags = ner_list( words );
   vector<UnicodeString> ner_file_tags = orig_ner_file_tags;
   if ( override ){
     vector<tc_pair> orig_ners;
@@ -134,45 +223,29 @@ void spit_out( ostream& os,
     for ( const auto& it : gazet_tags ){
       gazet_ners.push_back( make_pair( it, 1.0 ) );
     }
+    lock_guard<mutex> guard( ner_lock );
     myNer.merge_override( orig_ners, gazet_ners, bootstrap, tags );
   }
   if ( bootstrap ){
     for ( size_t i=0; i < words.size(); ++i ){
       UnicodeString line = words[i] + "\t";
       line += ner_file_tags[i];
-      os << line << endl;
+      os << line << "\n";
     }
   }
   else {
-    UnicodeString prevP = "_";
-    UnicodeString prevN = "_";
     for ( size_t i=0; i < words.size(); ++i ){
-      UnicodeString line = words[i] + "\t" + prevP + "\t" + tags[i] + "\t";
-      prevP = tags[i];
-      if ( i < words.size() - 1 ){
-	line += tags[i+1] + "\t";
-      }
-      else {
-	line += "_\t";
-      }
-      line += prevN + "\t" + gazet_tags[i] + "\t";
-      prevN = gazet_tags[i];
-      if ( i < words.size() - 1 ){
-	line += gazet_tags[i+1] + "\t";
-      }
-      else {
-	line += "_\t";
-      }
-      line += ner_file_tags[i];
-      os << line << endl;
+      os << words[i] << "\t";
+      window.write( os, "\t", i, tags, gazet_tags );
+      os << ner_file_tags[i] << "\n";
     }
   }
-  if ( EOS_MARK == "\n" ){
+  if ( eos_mark == "\n" ){
     // avoid spurious newlines!
-    os << endl;
+    os << "\n";
   }
   else {
-    os << EOS_MARK << endl;
+    os << eos_mark << "\n";
   }
 }
 
@@ -187,9 +260,10 @@ UnicodeString to_tag( const UnicodeString& label ){
   }
 }
 
-void boot_out( ostream& os,
-	       const vector<UnicodeString>& words ){
-  vector<UnicodeString> gazet_tags = myNer.create_ner_list( words );
+void boot_out( output_writer& os,
+	       const vector<UnicodeString>& words,
+	       const string& eos_mark ){
+  vector<UnicodeString> gazet_tags = ner_list( words );
   UnicodeString prev_tag;
   for ( size_t i=0; i < words.size(); ++i ){
     UnicodeString line = words[i] + "\t";
@@ -204,113 +278,380 @@ void boot_out( ostream& os,
       prev_tag = tag;
     }
     line += tag;
-    os << line << endl;
+    os << line << "\n";
   }
-  if ( EOS_MARK == "\n" ){
+  if ( eos_mark == "\n" ){
     // avoid spurious newlines!
-    os << endl;
+    os << "\n";
   }
   else {
-    os << EOS_MARK << endl;
+    os << eos_mark << "\n";
+  }
+}
+
+struct ner_sentence {
+  UnicodeString blob;                  // the words, one per line
+  vector<UnicodeString> ner_file_tags; // the tags as specified in the input
+  string eos_mark;                     // the EOS_MARK in effect after it
+  bool counted = true;                 // does it get a progress dot?
+  uint64_t bytes = 0;                  // the size of its input lines
+};
+
+using ner_batch = vector<ner_sentence>;
+
+struct ner_output {
+  string text;            // the instances for a batch
+  size_t counted = 0;     // the number of sentences for the progress dots
+  size_t sentences = 0;
+  uint64_t bytes = 0;     // the size of the input of the batch
+};
+
+void show_progress( const ner_output& result,
+		    size_t& HeartBeat,
+		    size_t& sentences,
+		    uint64_t& bytes ){
+  // print dots, or with --stats a progress line now and then
+  sentences += result.sentences;
+  bytes += result.bytes;
+  if ( progress.active() ){
+    progress.update( bytes, sentences );
+    return;
+  }
+  for ( size_t i=0; i < result.counted; ++i ){
+    if ( ++HeartBeat % 8000 == 0 ) {
+      cout << endl;
+    }
+    if ( HeartBeat % 100 == 0 ) {
+      cout << ".";
+      cout.flush();
+    }
   }
 }
 
-void create_train_file( MbtAPI *tagger,
-			const string& inpname,
-			const string& outname,
-			bool override ){
-  ofstream os( outname );
+size_t create_train_file( const vector<MbtAPI*>& taggers,
+			  const string& inpname,
+			  const string& outname,
+			  bool override ){
+  // POS tag the sentences of the NER trainingsfile, and add the gazetteer
+  // information.
+  // With more taggers, batches of sentences are handled by a pool of
+  // workers, each with its own tagger. The results are written in the
+  // original order, so the output is the same as with 1 tagger.
+  output_writer os( outname, true );
+  if ( !os ){
+    cerr << "could not open output file '" << outname << "'" << endl;
+    exit(EXIT_FAILURE);
+  }
   ifstream is( inpname );
-  string line;
-  UnicodeString blob;
-  vector<UnicodeString> ner_file_tags; // store the tags as specified in the input
-  size_t HeartBeat=0;
-  while ( getline( is, line ) ){
-    if ( line == "<utt>" ){
-      EOS_MARK = "<utt>";
-      line.clear();
+  const size_t batch_size = 100;
+  size_t tokens = 0;
+  size_t lines = 0;
+  uint64_t bytes_read = 0;
+  string bad_line;
+  // these run in the reader, the workers and the writer of the pipeline,
+  // next to each other
+  stopwatch parsing( stopwatch::THREAD );
+  stopwatch writing( stopwatch::THREAD );
+  vector<stopwatch> tagging( taggers.size(), stopwatch( stopwatch::THREAD ) );
+  vector<stopwatch> generating( taggers.size(),
+				stopwatch( stopwatch::THREAD ) );
+  auto read_batch = [&]( ner_batch& batch ){
+    if ( !bad_line.empty() ){
+      return false;
     }
-    if ( line.empty() ) {
-      if ( !blob.isEmpty() ){
-	vector<Tagger::TagResult> tagv = tagger->TagLine( blob );
-	spit_out( os, tagv, ner_file_tags, override, false );
-	if ( ++HeartBeat % 8000 == 0 ) {
-	  cout << endl;
-	}
-	if ( HeartBeat % 100 == 0 ) {
-	  cout << ".";
-	  cout.flush();
+    parsing.start();
+    ner_sentence sentence;
+    string line;
+    while ( batch.size() < batch_size
+	    && getline( is, line ) ){
+      ++lines;
+      bytes_read += line.size() + 1;
+      sentence.bytes += line.size() + 1;
+      if ( line == "<utt>" ){
+	EOS_MARK = "<utt>";
+	line.clear();
+      }
+      if ( line.empty() ) {
+	if ( !sentence.blob.isEmpty() ){
+	  sentence.eos_mark = EOS_MARK;
+	  batch.push_back( std::move(sentence) );
+	  sentence = ner_sentence();
 	}
-	blob.remove();
-	ner_file_tags.clear();
+	continue;
       }
-      continue;
+      vector<UnicodeString> parts = TiCC::split( TiCC::UnicodeFromUTF8( line ) );
+      if ( parts.size() != 2 ){
+	// stop reading. we bail out after all previous sentences are done
+	bad_line = line;
+	break;
+      }
+      sentence.blob += parts[0] + "\n";
+      sentence.ner_file_tags.push_back( parts[1] );
+      ++tokens;
     }
-    vector<UnicodeString> parts = TiCC::split( TiCC::UnicodeFromUTF8( line ) );
-    if ( parts.size() != 2 ){
-      cerr << "DOOD: " << line << endl;
-      exit(EXIT_FAILURE);
+    if ( !sentence.blob.isEmpty() && bad_line.empty() ){
+      // the last sentence, without a separator
+      sentence.eos_mark = EOS_MARK;
+      sentence.counted = false;
+      batch.push_back( std::move(sentence) );
+    }
+    parsing.stop();
+    return !batch.empty();
+  };
+  auto tag_batch = [&]( size_t id, ner_batch& batch ){
+    ner_output result;
+    output_writer buf; // in memory
+    vector<UnicodeString> words;
+    vector<UnicodeString> tags;
+    for ( const auto& sentence : batch ){
+      tagging[id].start();
+      tag_sentence( taggers[id], sentence.blob, words, tags );
+      tagging[id].stop();
+      generating[id].start();
+      spit_out( buf, words, tags, sentence.ner_file_tags, override, false,
+		sentence.eos_mark );
+      generating[id].stop();
+      if ( sentence.counted ){
+	++result.counted;
+      }
+      result.bytes += sentence.bytes;
     }
-    blob += parts[0] + "\n";
-    ner_file_tags.push_back( parts[1] );
+    result.sentences = batch.size();
+    result.text = buf.str();
+    return result;
+  };
+  size_t HeartBeat=0;
+  size_t sentences = 0;
+  uint64_t bytes_done = 0;
+  auto write_batch = [&]( ner_output& result ){
+    writing.start();
+    os << result.text;
+    writing.stop();
+    show_progress( result, HeartBeat, sentences, bytes_done );
+  };
+  ordered_pipeline<ner_batch,ner_output> pipeline( taggers.size(),
+						   4*taggers.size() );
+  pipeline.run( read_batch, tag_batch, write_batch );
+  if ( !bad_line.empty() ){
+    cerr << "DOOD: " << bad_line << endl;
+    exit(EXIT_FAILURE);
   }
-  if ( !blob.isEmpty() ){
-    vector<Tagger::TagResult> tagv = tagger->TagLine( blob );
-    spit_out( os, tagv, ner_file_tags, override, false );
+  writing.start();
+  if ( !os.close() ){
+    cerr << "writing to '" << outname << "' failed" << endl;
+    exit(EXIT_FAILURE);
   }
+  writing.stop();
+  progress.finish( bytes_read, sentences );
+  // with more workers, these are the times summed over all workers
+  stopwatch tag_time;
+  stopwatch generate_time;
+  for ( size_t i=0; i < taggers.size(); ++i ){
+    tag_time += tagging[i];
+    generate_time += generating[i];
+  }
+  timings.add( "parsing", parsing, tokens );
+  timings.add( "tagging", tag_time, tokens );
+  timings.add( "instance generation", generate_time, tokens );
+  timings.add( "writing", writing, tokens );
+  timings.count( "lines", lines );
+  timings.count( "tokens", tokens );
+  timings.count( "sentences", sentences );
+  timings.count( "bytes_read", bytes_read );
+  timings.count( "bytes_written", os.bytes_written() );
+  return tokens;
 }
 
+struct boot_sentence {
+  vector<UnicodeString> words;
+  string eos_mark;                     // the EOS_MARK in effect after it
+  bool counted = true;                 // does it get a progress dot?
+  uint64_t bytes = 0;                  // the size of its input lines
+};
+
+using boot_batch = vector<boot_sentence>;
+
 void create_boot_file( const string& inpname,
 		       const string& outname,
 		       bool running=false ){
-  ofstream os( outname );
+  // tag the sentences using the gazetteer only.
+  // Large batches of sentences are handled by a pool of workers, and
+  // written in the original order, so the output is the same for any
+  // number of threads.
+  output_writer os( outname, true );
+  if ( !os ){
+    cerr << "could not open output file '" << outname << "'" << endl;
+    exit(EXIT_FAILURE);
+  }
   ifstream is( inpname );
-  string line;
+  const size_t batch_size = 1000;
+  size_t sentences = 0;
+  size_t tokens = 0;
+  size_t lines = 0;
+  uint64_t bytes_read = 0;
+  uint64_t pending_bytes = 0; // read, but not in a sentence yet
+  string bad_line;
+  stopwatch total;
+  // these run in the reader, the workers and the writer of the pipeline,
+  // next to each other
+  stopwatch parsing( stopwatch::THREAD );
+  stopwatch writing( stopwatch::THREAD );
+  vector<stopwatch> lookup( num_threads, stopwatch( stopwatch::THREAD ) );
   UnicodeString blob;
-  size_t HeartBeat=0;
-  while ( getline( is, line ) ){
-    if ( line == "<utt>" ){
-      EOS_MARK = "<utt>";
-      line.clear();
+  auto read_batch = [&]( boot_batch& batch ){
+    if ( !bad_line.empty() ){
+      return false;
     }
-    if ( line.empty() ) {
-      if ( !blob.isEmpty() ){
-	vector<UnicodeString> words = TiCC::split( blob );
-	boot_out( os, words );
-	if ( ++HeartBeat % 8000 == 0 ) {
-	  cout << endl;
+    parsing.start();
+    string line;
+    auto add_sentence = [&]( boot_sentence& sentence ){
+      sentence.eos_mark = EOS_MARK;
+      sentence.bytes = pending_bytes;
+      pending_bytes = 0;
+      batch.push_back( std::move(sentence) );
+    };
+    while ( batch.size() < batch_size
+	    && getline( is, line ) ){
+      ++lines;
+      bytes_read += line.size() + 1;
+      pending_bytes += line.size() + 1;
+      if ( line == "<utt>" ){
+	EOS_MARK = "<utt>";
+	line.clear();
+      }
+      if ( line.empty() ) {
+	if ( !blob.isEmpty() ){
+	  boot_sentence sentence;
+	  sentence.words = TiCC::split( blob );
+	  add_sentence( sentence );
+	  blob.remove();
+	}
+	continue;
+      }
+      if ( running ){
+	boot_sentence sentence;
+	sentence.words = TiCC::split( TiCC::UnicodeFromUTF8(line) );
+	sentence.counted = false;
+	add_sentence( sentence );
+      }
+      else {
+	vector<UnicodeString> parts = TiCC::split( TiCC::UnicodeFromUTF8(line) );
+	if ( parts.size() == 2 ){
+	  blob += parts[0] + " ";
 	}
-	if ( HeartBeat % 100 == 0 ) {
-	  cout << ".";
-	  cout.flush();
+	else {
+	  // stop reading. we bail out after all previous sentences are done
+	  bad_line = line;
+	  break;
 	}
-	blob.remove();
       }
-      continue;
     }
-    if ( running ){
-      vector<UnicodeString> words = TiCC::split( TiCC::UnicodeFromUTF8(line) );
-      boot_out( os, words );
+    if ( is.eof() && !blob.isEmpty() && bad_line.empty() ){
+      // the last sentence, without a separator
+      boot_sentence sentence;
+      sentence.words = TiCC::split( blob );
+      sentence.counted = false;
+      add_sentence( sentence );
+      blob.remove();
     }
-    else {
-      vector<UnicodeString> parts = TiCC::split( TiCC::UnicodeFromUTF8(line) );
-      if ( parts.size() == 2 ){
-	blob += parts[0] + " ";
-      }
-      else {
-	cerr << "DOOD: " << line << endl;
-	exit(EXIT_FAILURE);
+    for ( const auto& sentence : batch ){
+      tokens += sentence.words.size();
+    }
+    sentences += batch.size();
+    parsing.stop();
+    return !batch.empty();
+  };
+  auto tag_batch = [&]( size_t id, boot_batch& batch ){
+    ner_output result;
+    output_writer buf; // in memory
+    lookup[id].start();
+    for ( const auto& sentence : batch ){
+      boot_out( buf, sentence.words, sentence.eos_mark );
+      if ( sentence.counted ){
+	++result.counted;
       }
+      result.bytes += sentence.bytes;
     }
+    lookup[id].stop();
+    result.sentences = batch.size();
+    result.text = buf.str();
+    return result;
+  };
+  size_t HeartBeat=0;
+  size_t done = 0;
+  uint64_t bytes_done = 0;
+  auto write_batch = [&]( ner_output& result ){
+    writing.start();
+    os << result.text;
+    writing.stop();
+    show_progress( result, HeartBeat, done, bytes_done );
+  };
+  // the lookups are all the work here. Without the compiled index they
+  // are done one at a time under ner_lock, so more workers would only
+  // wait for each other. Say so, --threads is silently useless otherwise.
+  int workers = num_threads;
+  if ( workers > 1 && !gazetteer.is_open() ){
+    cerr << "WARNING: --threads " << num_threads << " is ignored for "
+	 << "--bootstrap without the index of --compile-gazetteer.\n"
+	 << "\t the gazetteer lists can't be searched concurrently, so"
+	 << " bootstrapping with 1 thread.\n"
+	 << "\t run nergen once with --compile-gazetteer first, the index gives"
+	 << " the same results." << endl;
+    workers = 1;
+  }
+  total.start();
+  ordered_pipeline<boot_batch,ner_output> pipeline( workers, 4*workers );
+  pipeline.run( read_batch, tag_batch, write_batch );
+  if ( !bad_line.empty() ){
+    cerr << "DOOD: " << bad_line << endl;
+    exit(EXIT_FAILURE);
   }
-  if ( !blob.isEmpty() ){
-    vector<UnicodeString> words = TiCC::split( blob );
-    boot_out( os, words );
+  writing.start();
+  if ( !os.close() ){
+    cerr << "writing to '" << outname << "' failed" << endl;
+    exit(EXIT_FAILURE);
+  }
+  writing.stop();
+  total.stop();
+  progress.finish( bytes_read, sentences );
+  stopwatch lookup_time;
+  for ( const auto& sw : lookup ){
+    lookup_time += sw;
+  }
+  timings.add( "parsing", parsing, tokens );
+  timings.add( "bootstrapping", lookup_time, tokens );
+  timings.add( "writing", writing, tokens );
+  timings.count( "lines", lines );
+  timings.count( "tokens", tokens );
+  timings.count( "sentences", sentences );
+  timings.count( "bytes_read", bytes_read );
+  timings.count( "bytes_written", os.bytes_written() );
+  cout << endl << "bootstrapped " << sentences << " sentences in "
+       << total.seconds() << " seconds";
+  if ( total.seconds() > 0 ){
+    cout << " (" << size_t( sentences / total.seconds() )
+	 << " sentences/sec)";
+  }
+  cout << endl;
+}
+
+bool store_timings(){
+  // write the JSON summary for --timings, or with --stats to cout
+  if ( !timings_file.empty() ){
+    if ( !timings.write_json( timings_file, "nergen" ) ){
+      cerr << "unable to write timings to: " << timings_file << endl;
+      return false;
+    }
+    cout << "stored the timings in: " << timings_file << endl;
+  }
+  else if ( report_progress ){
+    timings.write_json( cout, "nergen" );
   }
+  return true;
 }
 
 int main(int argc, char * const argv[] ) {
-  TiCC::CL_Options opts("b:O:c:hVg:X","gazeteer:,help,version,override,bootstrap,running");
+  TiCC::CL_Options opts("b:O:c:hVg:X","gazeteer:,help,version,override,bootstrap,running,timings:,threads:,compile-gazetteer,tag-cache:,stats");
   try {
     opts.parse_args( argc, argv );
   }
@@ -344,6 +685,18 @@ int main(int argc, char * const argv[] ) {
   }
   bool keepX = opts.extract( 'X' );
   opts.extract( 'O', outputdir );
+  opts.extract( "timings", timings_file );
+  report_progress = opts.extract( "stats" );
+  string tag_cache_name;
+  opts.extract( "tag-cache", tag_cache_name );
+  string value;
+  if ( opts.extract( "threads", value ) ){
+    if ( !TiCC::stringTo( value, num_threads )
+	 || num_threads < 1 ){
+      cerr << "illegal value for --threads (" << value << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+  }
   if ( !outputdir.empty() ){
     if ( outputdir[outputdir.length()-1] != '/' )
       outputdir += "/";
@@ -362,6 +715,9 @@ int main(int argc, char * const argv[] ) {
   cerr << "default cfdir=" << default_config.configDir() << endl;
   use_config.merge( default_config ); // to be sure to have all we need
   cerr << "na merge cfdir=" << use_config.configDir() << endl;
+  if ( !context_window( use_config, "NER", window ) ){
+    exit( EXIT_FAILURE );
+  }
   if ( opts.extract( 'g', gazetteer_name )
        || opts.extract( "gazeteer", gazetteer_name ) ){
   }
@@ -373,8 +729,26 @@ int main(int argc, char * const argv[] ) {
     cerr << "WARNING: missing gazetteer option (-g). " << endl;
     cerr << "Are u sure ?" << endl;
   }
-  if ( !fill_gazet( gazetteer_name ) ){
-    exit( EXIT_FAILURE );
+  if ( opts.extract( "compile-gazetteer" ) ){
+    size_t max_ner_size = 15;
+    string max_size = use_config.lookUp( "max_ner_size", "NER" );
+    if ( !max_size.empty()
+	 && !TiCC::stringTo( max_size, max_ner_size ) ){
+      cerr << "illegal value for max_ner_size (" << max_size << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+    if ( !gazetteer_index::compile( gazetteer_name,
+				    gazetteer_name + ".idx",
+				    max_ner_size ) ){
+      exit( EXIT_FAILURE );
+    }
+    exit( EXIT_SUCCESS );
+  }
+  if ( gazetteer_name.empty()
+       || !open_gazet_index( gazetteer_name ) ){
+    if ( !fill_gazet( gazetteer_name ) ){
+      exit( EXIT_FAILURE );
+    }
   }
   override = opts.extract( "override" );
   bootstrap = opts.extract( "bootstrap" );
@@ -432,8 +806,14 @@ int main(int argc, char * const argv[] ) {
   string outname = outputdir + base_name;
   if ( bootstrap ){
     outname += ".boosted";
+    if ( report_progress ){
+      progress.start( "sentences", inpname );
+    }
     create_boot_file( inpname, outname, running );
-    cout << endl << "Created a new bootstrapped nergen data file: " << outname << endl;
+    cout << "Created a new bootstrapped nergen data file: " << outname << endl;
+    if ( !store_timings() ){
+      return EXIT_FAILURE;
+    }
     return EXIT_SUCCESS;
   }
   string mbt_setting = use_config.lookUp( "settings", "tagger" );
@@ -441,23 +821,58 @@ int main(int argc, char * const argv[] ) {
     throw setting_error( "settings", "tagger" );
   }
   string use_dir = use_config.configDir();
+  string mbt_settings_file;
   if ( use_dir.empty() ){
-    mbt_setting = "-s " + outputdir + mbt_setting + " -vcf" ;
+    mbt_settings_file = outputdir + mbt_setting;
   }
   else {
-    mbt_setting = "-s " + use_dir + mbt_setting + " -vcf" ;
-  }
-  MbtAPI *PosTagger = new MbtAPI( mbt_setting, mylog );
-  if ( !PosTagger->isInit() ){
-    cerr << "unable to initialize a POS tagger using:" << mbt_setting << endl;
-    exit( EXIT_FAILURE );
+    mbt_settings_file = use_dir + mbt_setting;
+  }
+  mbt_setting = "-s " + mbt_settings_file + " -vcf" ;
+  if ( !tag_cache_name.empty() ){
+    // the path of the settings is left out, only "-vcf" matters
+    string fingerprint = tag_cache::tagger_fingerprint( mbt_settings_file,
+							 "-vcf" );
+    if ( fingerprint.empty() ){
+      cerr << "unable to read the tagger settings: " << mbt_settings_file
+	   << endl;
+      exit( EXIT_FAILURE );
+    }
+    if ( !tagging_cache.open( tag_cache_name, fingerprint ) ){
+      exit( EXIT_FAILURE );
+    }
+    cout << "using tag cache: " << tag_cache_name << " ("
+	 << tagging_cache.size() << " sentences)" << endl;
+  }
+  vector<MbtAPI*> PosTaggers;
+  for ( int i=0; i < num_threads; ++i ){
+    // every thread needs a tagger of its own
+    MbtAPI *PosTagger = new MbtAPI( mbt_setting, mylog );
+    if ( !PosTagger->isInit() ){
+      cerr << "unable to initialize a POS tagger using:" << mbt_setting << endl;
+      exit( EXIT_FAILURE );
+    }
+    PosTaggers.push_back( PosTagger );
   }
   outname += ".data";
   string settings_name = outputdir + base_name + ".settings";
-  cout << "Start enriching: " << inpname << " with POS tags"
-       << " (every dot represents 100 tagged sentences)" << endl;
-  create_train_file( PosTagger, inpname, outname, override );
+  if ( !report_progress ){
+    cout << "Start enriching: " << inpname << " with POS tags"
+	 << " (every dot represents 100 tagged sentences)" << endl;
+  }
+  else {
+    cout << "Start enriching: " << inpname << " with POS tags" << endl;
+    progress.start( "sentences", inpname );
+  }
+  size_t tokens = create_train_file( PosTaggers, inpname, outname, override );
   cout << endl << "Created a trainingfile: " << outname << endl;
+  if ( tagging_cache.is_open() ){
+    cout << "tag cache: " << tagging_cache.hits() << " hits, "
+	 << tagging_cache.misses() << " misses" << endl;
+    if ( !tagging_cache.save() ){
+      exit( EXIT_FAILURE );
+    }
+  }
   string taggercommand = "-E " + outname
     + " -s " + settings_name
     + " -p " + p_pat + " -P " + P_pat
@@ -475,7 +890,11 @@ int main(int argc, char * const argv[] ) {
   cout << "start tagger: " << taggercommand << endl;
   cout << "this may take several minutes, depending on the corpus size."
        << endl;
+  stopwatch training;
+  training.start();
   MbtAPI::GenerateTagger( taggercommand );
+  training.stop();
+  timings.add( "training", training, tokens );
   cout << "finished tagger" << endl;
   // create a new configfile, based on the use_config
   // first clear unwanted stuff
@@ -511,5 +930,8 @@ int main(int argc, char * const argv[] ) {
   }
   output_config.create_configfile( cfg_out );
   cout << "stored a frog configfile template: " << cfg_out << endl;
+  if ( !store_timings() ){
+    return EXIT_FAILURE;
+  }
   return EXIT_SUCCESS;
 }
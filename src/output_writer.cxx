@@ -0,0 +1,212 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include "unicode/bytestream.h"
+#include "toad/output_writer.h"
+
+using namespace std;
+
+static const size_t block_size = 1024*1024;
+
+output_writer::output_writer():
+  _fd( -1 ),
+  _failed( false ),
+  _done( false ),
+  _written( 0 )
+{
+}
+
+output_writer::output_writer( const string& filename, bool background ):
+  output_writer()
+{
+  open( filename, background );
+}
+
+output_writer::~output_writer(){
+  close();
+}
+
+bool output_writer::open( const string& filename, bool background ){
+  close();
+  _buffer.clear();
+  _failed = false;
+  _written = 0;
+  _fd = ::open( filename.c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0666 );
+  if ( _fd < 0 ){
+    _failed = true;
+    return false;
+  }
+  _buffer.reserve( block_size + block_size/8 );
+  if ( background ){
+    _done = false;
+    _thread = thread( &output_writer::background_writer, this );
+  }
+  return true;
+}
+
+bool output_writer::close(){
+  // write what is left, and wait for the background thread
+  if ( _fd < 0 ){
+    return !_failed;
+  }
+  if ( _thread.joinable() ){
+    {
+      unique_lock<mutex> lock( _lock );
+      _cv.wait( lock, [this]{ return _pending.empty(); } );
+      _pending.swap( _buffer );
+      _done = true;
+    }
+    _cv.notify_all();
+    _thread.join();
+  }
+  else {
+    write_block( _buffer );
+  }
+  _buffer.clear();
+  if ( ::close( _fd ) != 0 ){
+    _failed = true;
+  }
+  _fd = -1;
+  return !_failed;
+}
+
+bool output_writer::good() const {
+  lock_guard<mutex> lock( _lock );
+  return !_failed;
+}
+
+void output_writer::write_block( const string& block ){
+  // write the whole block, or fail
+  const char *data = block.data();
+  size_t left = block.size();
+  while ( left > 0 && !_failed ){
+    ssize_t n = ::write( _fd, data, left );
+    if ( n < 0 ){
+      if ( errno == EINTR ){
+	continue;
+      }
+      lock_guard<mutex> lock( _lock );
+      _failed = true;
+      break;
+    }
+    data += n;
+    left -= n;
+    _written += n;
+  }
+}
+
+void output_writer::background_writer(){
+  unique_lock<mutex> lock( _lock );
+  while ( true ){
+    _cv.wait( lock, [this]{ return !_pending.empty() || _done; } );
+    if ( !_pending.empty() ){
+      lock.unlock();
+      write_block( _pending );
+      lock.lock();
+      _pending.clear(); // keeps the capacity
+      _cv.notify_all();
+    }
+    else if ( _done ){
+      return;
+    }
+  }
+}
+
+void output_writer::next_block(){
+  // hand over a full block. Called when the buffer is full
+  if ( _thread.joinable() ){
+    {
+      unique_lock<mutex> lock( _lock );
+      _cv.wait( lock, [this]{ return _pending.empty(); } );
+      _pending.swap( _buffer );
+    }
+    _cv.notify_all();
+  }
+  else {
+    write_block( _buffer );
+  }
+  _buffer.clear();
+}
+
+output_writer& output_writer::write( const char *data, size_t len ){
+  _buffer.append( data, len );
+  if ( _fd >= 0 && _buffer.size() >= block_size ){
+    next_block();
+  }
+  return *this;
+}
+
+output_writer& output_writer::operator<<( const icu::UnicodeString& us ){
+  icu::StringByteSink<string> sink( &_buffer );
+  us.toUTF8( sink );
+  if ( _fd >= 0 && _buffer.size() >= block_size ){
+    next_block();
+  }
+  return *this;
+}
+
+output_writer& output_writer::operator<<( const char *s ){
+  return write( s, strlen( s ) );
+}
+
+output_writer& output_writer::operator<<( char c ){
+  return write( &c, 1 );
+}
+
+size_t utf8_unit( char16_t c, char *buf ){
+  // encode one UTF-16 unit, returns the number of bytes.
+  // A lone surrogate can't be encoded, it gives U+FFFD, like converting a
+  // UnicodeString does
+  if ( c < 0x80 ){
+    buf[0] = static_cast<char>( c );
+    return 1;
+  }
+  else if ( c < 0x800 ){
+    buf[0] = static_cast<char>( 0xC0 | ( c >> 6 ) );
+    buf[1] = static_cast<char>( 0x80 | ( c & 0x3F ) );
+    return 2;
+  }
+  if ( c >= 0xD800 && c <= 0xDFFF ){
+    c = 0xFFFD;
+  }
+  buf[0] = static_cast<char>( 0xE0 | ( c >> 12 ) );
+  buf[1] = static_cast<char>( 0x80 | ( ( c >> 6 ) & 0x3F ) );
+  buf[2] = static_cast<char>( 0x80 | ( c & 0x3F ) );
+  return 3;
+}
+
+output_writer& output_writer::operator<<( char16_t c ){
+  char buf[3];
+  return write( buf, utf8_unit( c, buf ) );
+}
+
+output_writer& output_writer::operator<<( size_t n ){
+  return *this << to_string( n );
+}
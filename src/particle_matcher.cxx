@@ -0,0 +1,178 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <algorithm>
+#include <deque>
+#include "unicode/utf16.h"
+#include "toad/particle_matcher.h"
+
+using namespace std;
+using namespace icu;
+
+const uint32_t NO_STATE = UINT32_MAX;
+
+particle_matcher::particle_matcher( const map<UnicodeString,
+				    set<UnicodeString>>& particles ){
+  // particles is a map of (partial) POS tags to the particles to try
+  // for those tags.
+  _states.resize( 1 ); // the root
+  map<UnicodeString,uint32_t> ids;
+  for ( const auto& [seek_tag,parts] : particles ){
+    vector<uint32_t> tag_ids;
+    for ( const auto& part : parts ){
+      auto it = ids.find( part );
+      if ( it != ids.end() ){
+	tag_ids.push_back( it->second );
+	continue;
+      }
+      uint32_t id = _particles.size();
+      ids[part] = id;
+      _particles.push_back( part );
+      tag_ids.push_back( id );
+      if ( part.isEmpty() ){
+	// indexOf() never finds an empty string. So neither do we
+	continue;
+      }
+      uint32_t s = 0;
+      for ( int i=0; i < part.length(); ++i ){
+	uint32_t n = go( s, part[i] );
+	if ( n == NO_STATE ){
+	  n = _states.size();
+	  _states.emplace_back();
+	  auto& next = _states[s].next;
+	  next.insert( upper_bound( next.begin(), next.end(),
+				    make_pair( part[i], uint32_t(0) ),
+				    []( const pair<char16_t,uint32_t>& a,
+					const pair<char16_t,uint32_t>& b ){
+				      return a.first < b.first;
+				    } ),
+		       make_pair( part[i], n ) );
+	}
+	s = n;
+      }
+      _states[s].out.push_back( id );
+    }
+    _tags.push_back( make_pair( seek_tag, tag_ids ) );
+  }
+  // breadth first, to set the failure links
+  deque<uint32_t> todo;
+  for ( const auto& [c,n] : _states[0].next ){
+    _states[n].fail = 0;
+    _states[n].out_link = NO_STATE;
+    todo.push_back( n );
+  }
+  _states[0].out_link = NO_STATE;
+  while ( !todo.empty() ){
+    uint32_t s = todo.front();
+    todo.pop_front();
+    for ( const auto& [c,n] : _states[s].next ){
+      uint32_t f = step( _states[s].fail, c );
+      _states[n].fail = f;
+      _states[n].out_link = _states[f].out.empty() ? _states[f].out_link : f;
+      todo.push_back( n );
+    }
+  }
+}
+
+uint32_t particle_matcher::go( uint32_t s, char16_t c ) const {
+  const auto& next = _states[s].next;
+  auto it = lower_bound( next.begin(), next.end(), make_pair( c, uint32_t(0) ),
+			 []( const pair<char16_t,uint32_t>& a,
+			     const pair<char16_t,uint32_t>& b ){
+			   return a.first < b.first;
+			 } );
+  if ( it != next.end() && it->first == c ){
+    return it->second;
+  }
+  return NO_STATE;
+}
+
+uint32_t particle_matcher::step( uint32_t s, char16_t c ) const {
+  while ( true ){
+    uint32_t n = go( s, c );
+    if ( n != NO_STATE ){
+      return n;
+    }
+    if ( s == 0 ){
+      return 0;
+    }
+    s = _states[s].fail;
+  }
+}
+
+vector<uint32_t> particle_matcher::candidates( const UnicodeString& tag ) const {
+  // the particles to try for this tag. In configuration order, which is:
+  // for every partial tag that is contained in 'tag', all its particles.
+  vector<uint32_t> result;
+  for ( const auto& [seek_tag,ids] : _tags ){
+    if ( tag.indexOf( seek_tag ) >= 0 ){
+      for ( const auto& id : ids ){
+	if ( find( result.begin(), result.end(), id ) == result.end() ){
+	  // trying the same particle twice would give the same result
+	  result.push_back( id );
+	}
+      }
+    }
+  }
+  return result;
+}
+
+void particle_matcher::first_positions( const UnicodeString& word,
+					vector<int>& positions ) const {
+  // for every particle, store the position where it first occurs in 'word'
+  // in 'positions'. -1 when not found.
+  // like UnicodeString::indexOf(), we don't accept matches that split a
+  // surrogate pair.
+  positions.assign( _particles.size(), -1 );
+  const char16_t *buf = word.getBuffer();
+  int len = word.length();
+  uint32_t s = 0;
+  for ( int i=0; i < len; ++i ){
+    s = step( s, buf[i] );
+    uint32_t o = _states[s].out.empty() ? _states[s].out_link : s;
+    while ( o != NO_STATE ){
+      for ( const auto& id : _states[o].out ){
+	if ( positions[id] != -1 ){
+	  continue;
+	}
+	int start = i + 1 - _particles[id].length();
+	int limit = i + 1;
+	if ( U16_IS_TRAIL( buf[start] )
+	     && start > 0
+	     && U16_IS_LEAD( buf[start-1] ) ){
+	  continue;
+	}
+	if ( U16_IS_LEAD( buf[limit-1] )
+	     && limit < len
+	     && U16_IS_TRAIL( buf[limit] ) ){
+	  continue;
+	}
+	positions[id] = start;
+      }
+      o = _states[o].out_link;
+    }
+  }
+}
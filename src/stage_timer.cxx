@@ -0,0 +1,277 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <ctime>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include "toad/stage_timer.h"
+
+using namespace std;
+
+static double thread_cpu(){
+  // the CPU time used by the calling thread
+  struct timespec ts;
+  if ( clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts ) != 0 ){
+    return 0.0;
+  }
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double process_cpu(){
+  // the user and system time of this process, over all threads
+  struct rusage usage;
+  if ( getrusage( RUSAGE_SELF, &usage ) != 0 ){
+    return 0.0;
+  }
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+    + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static double cpu_now( stopwatch::cpu_scope scope ){
+  return scope == stopwatch::THREAD ? thread_cpu() : process_cpu();
+}
+
+void stopwatch::start(){
+  if ( !_running ){
+    _start = chrono::steady_clock::now();
+    _cpu_start = cpu_now( _scope );
+    _running = true;
+  }
+}
+
+void stopwatch::stop(){
+  if ( _running ){
+    chrono::duration<double> d = chrono::steady_clock::now() - _start;
+    _total += d.count();
+    _cpu_total += cpu_now( _scope ) - _cpu_start;
+    _running = false;
+  }
+}
+
+stopwatch& stopwatch::operator+=( const stopwatch& other ){
+  _total += other._total;
+  _cpu_total += other._cpu_total;
+  return *this;
+}
+
+stopwatch& stopwatch::operator-=( const stopwatch& other ){
+  _total -= other._total;
+  _cpu_total -= other._cpu_total;
+  return *this;
+}
+
+stage_timer::stage_timer():
+  _begin( chrono::steady_clock::now() )
+{
+}
+
+void stage_timer::add( const string& name,
+		       const stopwatch& sw,
+		       size_t tokens ){
+  lock_guard<mutex> guard( _lock );
+  for ( auto& s : _stages ){
+    if ( s.name == name ){
+      s.seconds += sw.seconds();
+      s.cpu_seconds += sw.cpu_seconds();
+      s.tokens += tokens;
+      return;
+    }
+  }
+  _stages.push_back( { name, sw.seconds(), sw.cpu_seconds(), tokens } );
+}
+
+void stage_timer::count( const string& name, uint64_t n ){
+  lock_guard<mutex> guard( _lock );
+  for ( auto& c : _counts ){
+    if ( c.first == name ){
+      c.second += n;
+      return;
+    }
+  }
+  _counts.push_back( make_pair( name, n ) );
+}
+
+double stage_timer::elapsed() const {
+  chrono::duration<double> d = chrono::steady_clock::now() - _begin;
+  return d.count();
+}
+
+long stage_timer::peak_rss(){
+  // the maximum resident set size of this process, in kilobytes
+  struct rusage usage;
+  if ( getrusage( RUSAGE_SELF, &usage ) != 0 ){
+    return -1;
+  }
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024; // in bytes there
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+double stage_timer::cpu_seconds(){
+  return process_cpu();
+}
+
+static string json_string( const string& s ){
+  string result = "\"";
+  for ( const auto c : s ){
+    if ( c == '"' || c == '\\' ){
+      result += '\\';
+    }
+    result += c;
+  }
+  return result + "\"";
+}
+
+static double per_second( uint64_t tokens, double seconds ){
+  return seconds > 0 ? tokens / seconds : 0.0;
+}
+
+void stage_timer::write_json( ostream& os, const string& program ) const {
+  lock_guard<mutex> guard( _lock );
+  ios::fmtflags flags = os.flags();
+  streamsize precision = os.precision();
+  os << fixed << setprecision(3);
+  os << "{" << endl;
+  os << "  \"program\": " << json_string( program ) << "," << endl;
+  double wall = elapsed();
+  os << "  \"wall_seconds\": " << wall << "," << endl;
+  os << "  \"cpu_seconds\": " << cpu_seconds() << "," << endl;
+  os << "  \"peak_rss_kb\": " << peak_rss() << "," << endl;
+  for ( const auto& c : _counts ){
+    os << "  " << json_string( c.first ) << ": " << c.second << "," << endl;
+    os << "  " << json_string( c.first + "_per_second" ) << ": "
+       << per_second( c.second, wall ) << "," << endl;
+  }
+  os << "  \"stages\": [";
+  for ( size_t i=0; i < _stages.size(); ++i ){
+    const stage& s = _stages[i];
+    os << ( i == 0 ? "" : "," ) << endl;
+    os << "    { \"name\": " << json_string( s.name )
+       << ", \"seconds\": " << s.seconds
+       << ", \"cpu_seconds\": " << s.cpu_seconds
+       << ", \"tokens\": " << s.tokens
+       << ", \"tokens_per_second\": " << per_second( s.tokens, s.seconds )
+       << " }";
+  }
+  os << endl << "  ]" << endl;
+  os << "}" << endl;
+  os.flags( flags );
+  os.precision( precision );
+}
+
+bool stage_timer::write_json( const string& filename,
+			      const string& program ) const {
+  ofstream os( filename );
+  if ( !os ){
+    return false;
+  }
+  write_json( os, program );
+  return os.good();
+}
+
+progress_meter::progress_meter():
+  _active( false ),
+  _total_bytes( 0 ),
+  _interval( 10.0 )
+{
+}
+
+void progress_meter::start( const string& unit,
+			    const string& input_file,
+			    double interval ){
+  // 'unit' names the things counted, like "sentences".
+  struct stat st;
+  _total_bytes = 0;
+  if ( stat( input_file.c_str(), &st ) == 0 && S_ISREG( st.st_mode ) ){
+    _total_bytes = st.st_size;
+  }
+  _active = true;
+  _unit = unit;
+  _interval = interval;
+  _begin = chrono::steady_clock::now();
+  _next = _begin + chrono::duration_cast<chrono::steady_clock::duration>(
+    chrono::duration<double>( interval ) );
+}
+
+void progress_meter::update( uint64_t bytes, size_t items ){
+  if ( !_active ){
+    return;
+  }
+  auto now = chrono::steady_clock::now();
+  if ( now < _next ){
+    return;
+  }
+  _next = now + chrono::duration_cast<chrono::steady_clock::duration>(
+    chrono::duration<double>( _interval ) );
+  report( bytes, items, false );
+}
+
+void progress_meter::finish( uint64_t bytes, size_t items ){
+  if ( _active ){
+    report( bytes, items, true );
+    _active = false;
+  }
+}
+
+static string hms( double seconds ){
+  long s = seconds + 0.5;
+  char buf[32];
+  snprintf( buf, sizeof(buf), "%ld:%02ld:%02ld", s / 3600, (s / 60) % 60,
+	    s % 60 );
+  return buf;
+}
+
+void progress_meter::report( uint64_t bytes, size_t items, bool done ){
+  // the line is formatted in a local stream, so the format flags of cout
+  // are left alone
+  chrono::duration<double> d = chrono::steady_clock::now() - _begin;
+  double elapsed = d.count();
+  ostringstream os;
+  os << ( done ? "done: " : "progress: " ) << fixed << setprecision(1);
+  if ( _total_bytes > 0 ){
+    os << 100.0 * bytes / _total_bytes << "% of "
+       << _total_bytes / 1e6 << " MB, ";
+  }
+  else {
+    os << bytes / 1e6 << " MB, ";
+  }
+  os << items << " " << _unit << " (" << setprecision(0)
+     << per_second( items, elapsed ) << " per second, " << setprecision(1)
+     << per_second( bytes, elapsed ) / 1e6 << " MB/s), elapsed "
+     << hms( elapsed );
+  if ( !done && _total_bytes > 0 && bytes > 0 && bytes < _total_bytes ){
+    double remaining = elapsed * ( _total_bytes - bytes ) / bytes;
+    os << ", ETA " << hms( remaining );
+  }
+  cout << os.str() << endl;
+}
@@ -0,0 +1,229 @@
+/*
+  Copyright (c) 2015 - 2024
+  CLST Radboud University
+
+  This file is part of toad
+
+  toad is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  toad is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/toad/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include "toad/content_hash.h"
+#include "unicode/uchar.h"
+#include "toad/tag_cache.h"
+
+using namespace std;
+using namespace icu;
+
+static const string HEADER = "# toad tag cache ";
+
+static uint64_t sentence_key( const UnicodeString& sentence ){
+  string utf8;
+  sentence.toUTF8String( utf8 );
+  return content_hash().add( utf8 ).value();
+}
+
+tag_cache::tag_cache():
+  _rewrite( false ),
+  _hits( 0 ),
+  _misses( 0 )
+{
+}
+
+string tag_cache::tagger_fingerprint( const string& settings_file,
+				      const string& options ){
+  // hash the tagger options, the settings, and the contents of every file
+  // mentioned in them (like the lexicon and the trees).
+  // No paths are hashed, so the same tagger gives the same fingerprint, from
+  // wherever it is used. So 'options' should not hold the settings path.
+  // returns "" when the settings can't be read
+  ifstream is( settings_file );
+  if ( !is ){
+    return "";
+  }
+  content_hash h;
+  h.add( options );
+  string dir;
+  auto slash = settings_file.rfind( '/' );
+  if ( slash != string::npos ){
+    dir = settings_file.substr( 0, slash+1 );
+  }
+  string line;
+  while ( getline( is, line ) ){
+    istringstream ls( line );
+    string key;
+    string value;
+    if ( ls >> key >> value ){
+      string name = value;
+      if ( name[0] != '/' ){
+	name = dir + name;
+      }
+      h.add( key );
+      if ( h.add_file( name ) ){
+	continue;
+      }
+    }
+    // not a file: an option of the tagger
+    h.add( line );
+  }
+  return h.hex();
+}
+
+bool tag_cache::open( const string& filename, const string& fingerprint ){
+  // read the entries of 'filename', when it was made with the same tagger.
+  _filename = filename;
+  _fingerprint = fingerprint;
+  _entries.clear();
+  _added.clear();
+  _rewrite = true;
+  ifstream is( filename );
+  if ( !is ){
+    // a new cache
+    return true;
+  }
+  string line;
+  if ( !getline( is, line )
+       || line.compare( 0, HEADER.size(), HEADER ) != 0 ){
+    cerr << "not a tag cache: " << filename << endl;
+    _filename.clear();
+    return false;
+  }
+  if ( line.substr( HEADER.size() ) != fingerprint ){
+    cout << "the tagger changed, starting a new tag cache: " << filename
+	 << endl;
+    return true;
+  }
+  while ( getline( is, line ) ){
+    auto tab = line.find( '\t' );
+    if ( tab == string::npos ){
+      continue;
+    }
+    uint64_t key = strtoull( line.substr( 0, tab ).c_str(), 0, 16 );
+    // a later entry wins
+    _entries[key] = line.substr( tab+1 );
+  }
+  _rewrite = false;
+  return true;
+}
+
+bool tag_cache::lookup( const UnicodeString& sentence,
+			vector<UnicodeString>& words,
+			vector<UnicodeString>& tags ){
+  words.clear();
+  tags.clear();
+  if ( !is_open() ){
+    return false;
+  }
+  uint64_t key = sentence_key( sentence );
+  string value;
+  {
+    lock_guard<mutex> lock( _lock );
+    auto it = _entries.find( key );
+    if ( it == _entries.end() ){
+      ++_misses;
+      return false;
+    }
+    value = it->second;
+  }
+  istringstream is( value );
+  string word;
+  string tag;
+  while ( getline( is, word, '\t' ) && getline( is, tag, '\t' ) ){
+    words.push_back( UnicodeString::fromUTF8( word ) );
+    tags.push_back( UnicodeString::fromUTF8( tag ) );
+  }
+  // guard against hash collisions: the words must be the same
+  size_t i = 0;
+  bool same = true;
+  int32_t pos = 0;
+  while ( same && pos < sentence.length() ){
+    int32_t end = pos;
+    while ( end < sentence.length() && !u_isspace( sentence[end] ) ){
+      ++end;
+    }
+    if ( end > pos ){
+      same = i < words.size()
+	&& words[i] == UnicodeString( sentence, pos, end-pos );
+      ++i;
+    }
+    pos = end + 1;
+  }
+  lock_guard<mutex> lock( _lock );
+  if ( !same || i != words.size() ){
+    words.clear();
+    tags.clear();
+    ++_misses;
+    return false;
+  }
+  ++_hits;
+  return true;
+}
+
+void tag_cache::store( const UnicodeString& sentence,
+		       const vector<UnicodeString>& words,
+		       const vector<UnicodeString>& tags ){
+  if ( !is_open() ){
+    return;
+  }
+  string value;
+  for ( size_t i=0; i < words.size(); ++i ){
+    if ( i > 0 ){
+      value += '\t';
+    }
+    words[i].toUTF8String( value );
+    value += '\t';
+    tags[i].toUTF8String( value );
+  }
+  uint64_t key = sentence_key( sentence );
+  lock_guard<mutex> lock( _lock );
+  if ( _entries.insert( make_pair( key, value ) ).second ){
+    _added.push_back( key );
+  }
+}
+
+bool tag_cache::save(){
+  // append the new entries, or write them all when the file is new or the
+  // tagger changed
+  if ( !is_open() || ( !_rewrite && _added.empty() ) ){
+    return true;
+  }
+  ofstream os( _filename, _rewrite ? ios::trunc : ios::app );
+  if ( _rewrite ){
+    os << HEADER << _fingerprint << "\n";
+  }
+  char key[17];
+  for ( const auto& k : _added ){
+    snprintf( key, sizeof(key), "%016llx",
+	      static_cast<unsigned long long>(k) );
+    os << key << "\t" << _entries[k] << "\n";
+  }
+  os.close();
+  if ( !os ){
+    cerr << "unable to write the tag cache: " << _filename << endl;
+    return false;
+  }
+  _added.clear();
+  _rewrite = false;
+  return true;
+}